@@ -46,6 +46,10 @@ CLIENT_PATH = os.path.normpath(os.path.join(os.getcwd(), __file__))
 AI_PROCESS_PATH = os.path.join(os.path.dirname(CLIENT_PATH), 'dropblox_ai')
 NUM_HTTP_RETRIES = 2 # number of times to retry if http connection fails
 
+# If set, every game state handed to the AI is appended to this file as one
+# JSON line, in the corpus format read by the C++ replay tool.
+CORPUS_PATH = os.environ.get('DROPBLOX_CORPUS')
+
 is_windows = platform.system() == "Windows"
 
 # Printing utilities
@@ -185,7 +189,14 @@ class DropbloxServer(object):
         
         raise Exception("Bad response: %r" % (resp,))
 
+def record_state(game_state_dict, seconds_remaining):
+    with open(CORPUS_PATH, 'a') as f:
+        f.write(json.dumps({'state': game_state_dict,
+                            'seconds': seconds_remaining}) + '\n')
+
 def run_ai(game_state_dict, seconds_remaining):
+    if CORPUS_PATH:
+        record_state(game_state_dict, seconds_remaining)
     ai_arg_one = json.dumps(game_state_dict)
     ai_arg_two = json.dumps(seconds_remaining)
     command = Command(AI_PROCESS_PATH, ai_arg_one, ai_arg_two)
@@ -0,0 +1,113 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "batch.h"
+#include "corpus.h"
+
+using namespace std;
+
+static int usage(const char* name) {
+  cerr << "usage: " << name << " --batch FILE [--depth D] [--threads T]"
+       << " [--weights W]" << endl;
+  return 1;
+}
+
+// Searches the state on `line` and returns the chosen commands. Throws
+// json::Exception if the line does not parse.
+static string run_line(const string& line, int depth, const float* params) {
+  Document document;
+  Reader::Read(document, line);
+  const Value* record_state = document.Root().Find("state", 5);
+  Board board(record_state ? *record_state : document.Root());
+  memcpy(board.heuristic_params, params, sizeof(board.heuristic_params));
+  board.search(depth);
+  string chosen = join_commands(board.best);
+
+  delete board.block;
+  for (int i = 0; i < board.preview.size(); i++) {
+    delete board.preview[i];
+  }
+  return chosen;
+}
+
+int run_batch(int argc, char** argv) {
+  if (argc < 3) return usage(argv[0]);
+  const char* path = argv[2];
+  int depth = SEARCH_DEPTH;
+  float params[NUM_FEATURES];
+  memcpy(params, default_heuristic_params, sizeof(params));
+
+  for (int i = 3; i < argc; i++) {
+    if (i + 1 >= argc) return usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(argv[i - 1], "--depth")) {
+      depth = atoi(value);
+      if (depth < 0 || depth > MAX_SEARCH_DEPTH) {
+        cerr << "--depth must be between 0 and " << MAX_SEARCH_DEPTH << endl;
+        return 1;
+      }
+    } else if (!strcmp(argv[i - 1], "--threads")) {
+      omp_set_num_threads(max(1, atoi(value)));
+    } else if (!strcmp(argv[i - 1], "--weights")) {
+      if (!load_heuristic_params(value, params)) {
+        cerr << "bad weights: " << value << endl;
+        return 1;
+      }
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  // States are read up front so the search can hand them out to threads in
+  // any order; results are kept by index and written in input order.
+  vector<string> lines;
+  vector<int> line_numbers;
+  {
+    ifstream file;
+    if (strcmp(path, "-")) {
+      file.open(path);
+      if (!file) {
+        cerr << "cannot open " << path << endl;
+        return 1;
+      }
+    }
+    istream& in = strcmp(path, "-") ? file : cin;
+    string line;
+    for (int line_no = 1; getline(in, line); line_no++) {
+      if (line.find_first_not_of(" \t\r") == string::npos) {
+        continue;
+      }
+      lines.push_back(line);
+      line_numbers.push_back(line_no);
+    }
+  }
+
+  int n = lines.size();
+  vector<string> chosen(n);
+  vector<string> errors(n);
+  double start = omp_get_wtime();
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int k = 0; k < n; k++) {
+    try {
+      chosen[k] = run_line(lines[k], depth, params);
+    } catch (const json::Exception& e) {
+      errors[k] = e.what();
+    }
+  }
+  double elapsed = omp_get_wtime() - start;
+
+  int failed = 0;
+  for (int k = 0; k < n; k++) {
+    cout << chosen[k] << '\n';
+    if (!errors[k].empty()) {
+      cerr << "line " << line_numbers[k] << ": " << errors[k] << endl;
+      failed++;
+    }
+  }
+  cout.flush();
+  fprintf(stderr, "%d states at depth %d in %.2fs (%.0f states/s, %d threads)\n",
+          n, depth, elapsed, elapsed > 0 ? n / elapsed : 0.0, omp_get_max_threads());
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Batch mode: `./dropblox_ai --batch FILE` runs many game states through the
+// same search a real turn does, in one process and across all cores. Usage:
+//
+//   ./dropblox_ai --batch FILE [--depth D] [--threads T] [--weights W]
+//
+// FILE (or - for stdin) holds one state per line, either a bare game state
+// as passed to dropblox_ai or a corpus record (see corpus.h). One line per
+// state goes to stdout, in input order: the chosen commands separated by
+// spaces, which is the baseline format ./replay reads. A line that does not
+// parse gets an empty result, is reported on stderr, and makes the exit
+// status 1. A summary of the run goes to stderr.
+
+// Runs batch mode with dropblox_ai's arguments, argv[1] being "--batch".
+// Returns the exit status.
+int run_batch(int argc, char** argv);
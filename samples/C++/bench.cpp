@@ -0,0 +1,163 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "dropblox_ai.h"
+#include "fixtures.h"
+
+using namespace std;
+
+// Microbenchmarks for the engine's hot paths over fixed board fixtures. Run
+// with `make bench`, or ./dropblox_bench [filter] to time only the lines whose
+// fixture or operation name contains `filter`.
+//
+// Each operation is repeated until it has run for at least MIN_SECONDS and
+// reported in ns/op; the search operations also report nodes/s, where a node
+// is one placement scored by choose_move.
+
+#define MIN_SECONDS 0.2
+
+const char* filter = NULL;
+
+// Keeps results alive so the compiler cannot drop the timed work.
+volatile long long sink;
+
+void report(const char* fixture, const char* op, long long iterations,
+            double seconds, long long nodes) {
+  printf("%-8s %-24s %12.1f ns/op", fixture, op, seconds * 1e9 / iterations);
+  if (nodes) {
+    printf(" %12.0f nodes/s", nodes / seconds);
+  }
+  printf("\n");
+  fflush(stdout);
+}
+
+bool wanted(const char* fixture, const char* op) {
+  return !filter || strstr(fixture, filter) || strstr(op, filter);
+}
+
+// Runs `statement` in batches of doubling size until a batch takes at least
+// MIN_SECONDS, then reports the time per run. `nodes_per_op` may refer to
+// state left behind by the statement.
+#define BENCH(fixture, op, statement, nodes_per_op)                       \
+  if (wanted(fixture, op)) {                                              \
+    long long iterations = 1;                                             \
+    while (true) {                                                        \
+      double start = omp_get_wtime();                                     \
+      for (long long it = 0; it < iterations; it++) {                     \
+        statement;                                                        \
+      }                                                                   \
+      double elapsed = omp_get_wtime() - start;                           \
+      if (elapsed >= MIN_SECONDS) {                                       \
+        report(fixture, op, iterations, elapsed,                          \
+               (long long)(nodes_per_op) * iterations);                   \
+        break;                                                            \
+      }                                                                   \
+      iterations *= 2;                                                    \
+    }                                                                     \
+  }
+
+void bench_fixture(const Fixture& fixture) {
+  const char* name = fixture.name;
+  Board* board = make_board(fixture);
+  Block* block = board->block;
+
+  Bitmap scratch;
+  BENCH(name, "Board::check", sink += board->check(*block), 0);
+  // Per-piece setup once the shape has been seen.
+  BENCH(name, "Block (interned)", {
+    Block copy(block->center, block->offsets, block->size);
+    sink += copy.shape->id;
+  }, 0);
+
+  // Drop from every column the spawn rotation reaches.
+  BENCH(name, "Board::place", {
+    posn pos(0, (int)(it % 9) - 4, 0);
+    block->set_position(pos);
+    if (board->check(*block)) {
+      Board* child = board->place(pos);
+      sink += child->bitmap[ROWS - 1][0];
+      delete child;
+    }
+  }, 0);
+
+  // The copy is part of the timed work; see "copy bitmap" for its cost.
+  BENCH(name, "copy bitmap", {
+    memcpy(scratch, board->bitmap, sizeof(Bitmap));
+    sink += scratch[ROWS - 1][0];
+  }, 0);
+  BENCH(name, "Board::remove_rows", {
+    memcpy(scratch, board->bitmap, sizeof(Bitmap));
+    Board::remove_rows(&scratch);
+    sink += scratch[ROWS - 1][0];
+  }, 0);
+
+  BENCH(name, "count_holes", sink += Board::count_holes(board->bitmap), 0);
+  BENCH(name, "altitude", sink += Board::altitude(board->bitmap), 0);
+  BENCH(name, "full_cells", sink += Board::full_cells(board->bitmap), 0);
+  BENCH(name, "higher_slope", sink += Board::higher_slope(board->bitmap), 0);
+  BENCH(name, "roughness", sink += Board::roughness(board->bitmap), 0);
+  BENCH(name, "full_cells_weighted",
+        sink += Board::full_cells_weighted(board->bitmap), 0);
+  BENCH(name, "countComponents",
+        sink += Board::countComponents(board->bitmap), 0);
+  BENCH(name, "get_score", sink += (long long)board->get_score(board->bitmap), 0);
+  // The two ways choose_move can score a placement.
+  BENCH(name, "place + get_score", {
+    posn pos(0, (int)(it % 9) - 4, 0);
+    block->set_position(pos);
+    if (board->check(*block)) {
+      Board* child = board->place(pos);
+      sink += (long long)board->get_score(child->bitmap);
+      delete child;
+    }
+  }, 0);
+  FeatureCache cache;
+  board->cache_features(cache);
+  BENCH(name, "score_placement", {
+    posn pos(0, (int)(it % 9) - 4, 0);
+    block->set_position(pos);
+    if (board->check(*block)) {
+      sink += (long long)board->score_placement(cache, pos);
+    }
+  }, 0);
+  int features[NUM_FEATURES];
+  BENCH(name, "features (fused)", {
+    Board::features(board->bitmap, features);
+    sink += features[NUM_FEATURES - 1];
+  }, 0);
+
+  BENCH(name, "generate_moves", {
+    board->generate_moves();
+    sink += board->placements.size();
+  }, 0);
+  // What search() adds for the placement it picks.
+  const posn& last = board->placements.back();
+  BENCH(name, "commands_for", sink += board->commands_for(last).size(), 0);
+
+  const char* search_names[] = {"choose_move depth 0", "choose_move depth 1",
+                                "choose_move depth 2"};
+  for (int depth = 0; depth < 3; depth++) {
+    BENCH(name, search_names[depth], {
+      board->generate_moves();
+      board->choose_move(depth);
+      sink += board->best_placement.tx;
+    }, board->nodes);
+  }
+
+  delete board->block;
+  for (size_t i = 0; i < board->preview.size(); i++) {
+    delete board->preview[i];
+  }
+  delete board;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 1) {
+    filter = argv[1];
+  }
+  for (int i = 0; i < num_fixtures; i++) {
+    bench_fixture(fixtures[i]);
+  }
+  return 0;
+}
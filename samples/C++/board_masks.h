@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "row_tables.h"
+
+// The bit-level layer under the heuristics, templated on the board's
+// dimensions. A board is seen as one occupancy mask per row (bit j set if
+// column j is filled) and, where it helps, one per column (bit i set if row i
+// is filled). Everything is sized by the template arguments, so the
+// standard 33x12 board gets fixed-length loops over single-word masks and
+// row lookup tables, and other sizes are just other instantiations.
+
+// A mask too wide for one machine word, stored little-end first.
+template <int Words>
+struct WideMask {
+  unsigned long long w[Words];
+
+  WideMask operator|(const WideMask& o) const {
+    WideMask r;
+    for (int k = 0; k < Words; k++) r.w[k] = w[k] | o.w[k];
+    return r;
+  }
+  WideMask operator&(const WideMask& o) const {
+    WideMask r;
+    for (int k = 0; k < Words; k++) r.w[k] = w[k] & o.w[k];
+    return r;
+  }
+  WideMask operator^(const WideMask& o) const {
+    WideMask r;
+    for (int k = 0; k < Words; k++) r.w[k] = w[k] ^ o.w[k];
+    return r;
+  }
+  WideMask operator~() const {
+    WideMask r;
+    for (int k = 0; k < Words; k++) r.w[k] = ~w[k];
+    return r;
+  }
+  WideMask& operator|=(const WideMask& o) { return *this = *this | o; }
+  WideMask& operator&=(const WideMask& o) { return *this = *this & o; }
+  bool operator==(const WideMask& o) const {
+    for (int k = 0; k < Words; k++) {
+      if (w[k] != o.w[k]) return false;
+    }
+    return true;
+  }
+};
+
+// The narrowest mask type holding `Bits` bits.
+template <int Bits>
+struct MaskFor {
+  typedef typename std::conditional<
+      Bits <= 32, unsigned,
+      typename std::conditional<Bits <= 64, unsigned long long,
+                                WideMask<(Bits + 63) / 64> >::type>::type type;
+};
+
+// Bit operations on each mask type. `low_bits(n)` is the mask of bits
+// [0, n); `lowest_from(m, p)` is the lowest set bit at or above p, which the
+// caller guarantees exists. Shifts are by less than the mask's width.
+// `spread(seed, within)` is `seed` plus every bit of `within` joined to it by
+// an unbroken run of `within` bits, found with doubling shifts rather than
+// one bit at a time.
+template <class M>
+struct MaskOps {
+  static const int bits = 8 * sizeof(M);
+
+  static M low_bits(int n) { return n >= bits ? ~(M)0 : ((M)1 << n) - 1; }
+  static M bit(int j) { return (M)1 << j; }
+  static bool any(M m) { return m != 0; }
+  static int popcount(M m) {
+    return bits > 32 ? __builtin_popcountll(m) : __builtin_popcount(m);
+  }
+  static int lowest(M m) {
+    return bits > 32 ? __builtin_ctzll(m) : __builtin_ctz(m);
+  }
+  static void clear_lowest(M& m) { m &= m - 1; }
+  static int lowest_from(M m, int p) { return p + lowest(m >> p); }
+  static M shl(M m, int k) { return m << k; }
+  static M shr(M m, int k) { return m >> k; }
+  static M spread(M seed, M within) {
+    M up = seed, down = seed, up_runs = within, down_runs = within;
+    for (int k = 1; k < bits; k *= 2) {
+      up |= up_runs & (up << k);
+      up_runs &= up_runs << k;
+      down |= down_runs & (down >> k);
+      down_runs &= down_runs >> k;
+    }
+    return up | down;
+  }
+};
+
+template <int Words>
+struct MaskOps<WideMask<Words> > {
+  typedef WideMask<Words> M;
+
+  static M low_bits(int n) {
+    M r;
+    for (int k = 0; k < Words; k++) {
+      int in_word = std::min(std::max(n - 64 * k, 0), 64);
+      r.w[k] = in_word == 64 ? ~0ULL : (1ULL << in_word) - 1;
+    }
+    return r;
+  }
+  static M bit(int j) {
+    M r = low_bits(0);
+    r.w[j / 64] = 1ULL << (j % 64);
+    return r;
+  }
+  static bool any(const M& m) {
+    for (int k = 0; k < Words; k++) {
+      if (m.w[k]) return true;
+    }
+    return false;
+  }
+  static int popcount(const M& m) {
+    int count = 0;
+    for (int k = 0; k < Words; k++) count += __builtin_popcountll(m.w[k]);
+    return count;
+  }
+  static int lowest(const M& m) {
+    for (int k = 0;; k++) {
+      if (m.w[k]) return 64 * k + __builtin_ctzll(m.w[k]);
+    }
+  }
+  static void clear_lowest(M& m) {
+    for (int k = 0;; k++) {
+      if (m.w[k]) {
+        m.w[k] &= m.w[k] - 1;
+        return;
+      }
+    }
+  }
+  static int lowest_from(const M& m, int p) {
+    unsigned long long word = m.w[p / 64] >> (p % 64);
+    if (word) return p + __builtin_ctzll(word);
+    for (int k = p / 64 + 1;; k++) {
+      if (m.w[k]) return 64 * k + __builtin_ctzll(m.w[k]);
+    }
+  }
+  static M shl(const M& m, int n) {
+    M r;
+    int words = n / 64, b = n % 64;
+    for (int k = Words - 1; k >= 0; k--) {
+      int from = k - words;
+      r.w[k] = from < 0 ? 0 : m.w[from] << b;
+      if (b && from > 0) r.w[k] |= m.w[from - 1] >> (64 - b);
+    }
+    return r;
+  }
+  static M shr(const M& m, int n) {
+    M r;
+    int words = n / 64, b = n % 64;
+    for (int k = 0; k < Words; k++) {
+      int from = k + words;
+      r.w[k] = from >= Words ? 0 : m.w[from] >> b;
+      if (b && from + 1 < Words) r.w[k] |= m.w[from + 1] << (64 - b);
+    }
+    return r;
+  }
+  static M spread(const M& seed, const M& within) {
+    M up = seed, down = seed, up_runs = within, down_runs = within;
+    for (int k = 1; k < 64 * Words; k *= 2) {
+      up |= up_runs & shl(up, k);
+      up_runs &= shl(up_runs, k);
+      down |= down_runs & shr(down, k);
+      down_runs &= shr(down_runs, k);
+    }
+    return up | down;
+  }
+};
+
+template <int Rows, int Cols>
+struct BoardMasks {
+  typedef typename MaskFor<Cols>::type Row;
+  // One bit per row plus bit Rows, which stands for the floor.
+  typedef typename MaskFor<Rows + 1>::type Column;
+  typedef MaskOps<Row> RowOps;
+  typedef MaskOps<Column> ColumnOps;
+
+  static const bool tabled = Cols <= ROW_TABLE_MAX_COLS;
+
+  static Row full_row() { return RowOps::low_bits(Cols); }
+
+  // The occupancy mask of one bitmap row.
+  static Row row_mask(const int* row) {
+#ifdef __SSE2__
+    if constexpr (Cols == 12) {
+      // Three 4-wide compares against zero rather than a shift per cell.
+      __m128i zero = _mm_setzero_si128();
+      int empty =
+          _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+              _mm_loadu_si128((const __m128i*)row), zero))) |
+          _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+              _mm_loadu_si128((const __m128i*)(row + 4)), zero))) << 4 |
+          _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(
+              _mm_loadu_si128((const __m128i*)(row + 8)), zero))) << 8;
+      return ~empty & full_row();
+    }
+#endif
+    Row mask = RowOps::low_bits(0);
+    for (int j = 0; j < Cols; j++) {
+      if constexpr (std::is_integral<Row>::value) {
+        mask |= (Row)(row[j] != 0) << j;
+      } else if (row[j]) {
+        mask |= RowOps::bit(j);
+      }
+    }
+    return mask;
+  }
+
+  static void row_masks(const int (*bitmap)[Cols], Row* mask) {
+    for (int i = 0; i < Rows; i++) {
+      mask[i] = row_mask(bitmap[i]);
+    }
+  }
+
+  static int cells(const Row& m) {
+    if constexpr (tabled) {
+      return row_tables<Cols>.cells[m];
+    } else {
+      return RowOps::popcount(m);
+    }
+  }
+
+  // Bit j is set if a run of same-coloured cells starts at column j.
+  static Row run_starts(const Row& m) {
+    if constexpr (tabled) {
+      return row_tables<Cols>.run_starts[m];
+    } else {
+      return ((m ^ RowOps::shl(m, 1)) & full_row()) | RowOps::bit(0);
+    }
+  }
+
+  static int runs(const Row& m) {
+    if constexpr (tabled) {
+      return row_tables<Cols>.transitions[m] + 1;
+    } else {
+      return RowOps::popcount(run_starts(m));
+    }
+  }
+
+  // Each column's first filled row, Rows for an empty column.
+  static void column_tops(const Row* mask, int* top) {
+    Row unseen = full_row();
+    for (int j = 0; j < Cols; j++) top[j] = Rows;
+    for (int i = 0; i < Rows && RowOps::any(unseen); i++) {
+      for (Row fresh = mask[i] & unseen; RowOps::any(fresh);
+           RowOps::clear_lowest(fresh)) {
+        top[RowOps::lowest(fresh)] = i;
+      }
+      unseen &= ~mask[i];
+    }
+  }
+
+  static void column_masks(const Row* mask, Column* column) {
+    for (int j = 0; j < Cols; j++) column[j] = ColumnOps::bit(Rows);
+    for (int i = 0; i < Rows; i++) {
+      for (Row m = mask[i]; RowOps::any(m); RowOps::clear_lowest(m)) {
+        column[RowOps::lowest(m)] |= ColumnOps::bit(i);
+      }
+    }
+  }
+
+  // How many rows a square in row i of column j falls before it lands on a
+  // filled cell or the floor.
+  static int fall(const Column* column, int i, int j) {
+    return ColumnOps::lowest_from(column[j], i + 1) - i - 1;
+  }
+
+  // The slope from a non-empty column to a neighbour is how far the
+  // neighbour's top lies below its own; a higher neighbour counts as 0.
+  // `sum` is the roughness and `largest` the higher slope.
+  static void slopes(const int* top, int* sum, int* largest) {
+    *sum = *largest = 0;
+    for (int j = 0; j < Cols; j++) {
+      if (top[j] == Rows) continue;
+      if (j > 0 && top[j - 1] > top[j]) {
+        *sum += top[j - 1] - top[j];
+        *largest = std::max(*largest, top[j - 1] - top[j]);
+      }
+      if (j + 1 < Cols && top[j + 1] > top[j]) {
+        *sum += top[j + 1] - top[j];
+        *largest = std::max(*largest, top[j + 1] - top[j]);
+      }
+    }
+  }
+
+  // Counts 4-connected regions of same-coloured cells (filled or empty). Each
+  // maximal horizontal run starts as its own region and merges with the runs
+  // of the same colour it touches in the row above. Two touching runs first
+  // overlap at a column where one of them starts, so only those columns are
+  // checked. The empty rows above the stack are all one region, so counting
+  // starts at the last of them.
+  static int count_components(const Row* mask) {
+    int parent[Rows * Cols];
+    int first_run[Rows];
+    int total = 0, components = 0;
+    int sky = 0;
+    while (sky + 1 < Rows && !RowOps::any(mask[sky]) &&
+           !RowOps::any(mask[sky + 1])) {
+      sky++;
+    }
+    Row above = RowOps::low_bits(0);
+    for (int i = sky; i < Rows; i++) {
+      Row starts = run_starts(mask[i]);
+      int count = runs(mask[i]);
+      first_run[i] = total;
+      for (int r = total; r < total + count; r++) {
+        parent[r] = r;
+      }
+      total += count;
+      components += count;
+
+      if (i > sky) {
+        Row touching = ~(mask[i] ^ mask[i - 1]) & (starts | above) & full_row();
+        for (; RowOps::any(touching); RowOps::clear_lowest(touching)) {
+          int j = RowOps::lowest(touching);
+          Row upto = RowOps::low_bits(j + 1);
+          int a = find_run(parent, first_run[i] + RowOps::popcount(starts & upto) - 1);
+          int b = find_run(parent, first_run[i - 1] + RowOps::popcount(above & upto) - 1);
+          if (a != b) {
+            parent[a] = b;
+            components--;
+          }
+        }
+      }
+      above = starts;
+    }
+    return components;
+  }
+
+  // Every feature of get_score, in heuristic_params order.
+  static void features(const Row* mask, const int* top, int* out) {
+    int total = 0, weighted = 0, holes = 0;
+    for (int i = 0; i < Rows; i++) {
+      total += cells(mask[i]);
+      weighted += cells(mask[i]) * (Rows - i);
+    }
+    // Every filled cell sits at or below its column's top, so whatever else
+    // lies between the top and the floor is a hole.
+    for (int j = 0; j < Cols; j++) {
+      holes += Rows - top[j];
+    }
+    int altitude = 0;
+    while (altitude < Rows && RowOps::any(mask[Rows - 1 - altitude])) {
+      altitude++;
+    }
+    int rough, slope;
+    slopes(top, &rough, &slope);
+
+    out[0] = holes - total;
+    out[1] = altitude;
+    out[2] = total;
+    out[3] = slope;
+    out[4] = rough;
+    out[5] = weighted;
+    out[6] = count_components(mask);
+  }
+
+ private:
+  static int find_run(int* parent, int run) {
+    while (parent[run] != run) {
+      run = parent[run] = parent[parent[run]];
+    }
+    return run;
+  }
+};
@@ -0,0 +1,92 @@
+#include <sstream>
+
+#include "corpus.h"
+
+void write_block(ostream& out, const Block& block) {
+  out << "{\"center\": {\"i\": " << block.center.i
+      << ", \"j\": " << block.center.j << "}, \"offsets\": [";
+  for (int k = 0; k < block.size; k++) {
+    out << (k ? ", " : "") << "{\"i\": " << block.offsets[k].i
+        << ", \"j\": " << block.offsets[k].j << "}";
+  }
+  out << "]}";
+}
+
+void write_state(ostream& out, const Board& board) {
+  out << "{\"bitmap\": [";
+  for (int i = 0; i < ROWS; i++) {
+    out << (i ? ", [" : "[");
+    for (int j = 0; j < COLS; j++) {
+      out << (j ? ", " : "") << (board.bitmap[i][j] ? 1 : 0);
+    }
+    out << "]";
+  }
+  out << "], \"block\": ";
+  write_block(out, *board.block);
+  out << ", \"preview\": [";
+  for (int k = 0; k < board.preview.size(); k++) {
+    out << (k ? ", " : "");
+    write_block(out, *board.preview[k]);
+  }
+  out << "]}";
+}
+
+void write_record(ostream& out, const Board& board, double seconds) {
+  out << "{\"state\": ";
+  write_state(out, board);
+  if (seconds >= 0) {
+    out << ", \"seconds\": " << seconds;
+  }
+  out << "}\n";
+}
+
+//-----------------------------------------
+// CorpusReader implementation starts here!
+//-----------------------------------------
+
+CorpusReader::CorpusReader(istream& in) : in(in), line_no(0) {
+}
+
+bool CorpusReader::next() {
+  while (getline(in, line)) {
+    line_no++;
+    if (line.find_first_not_of(" \t\r") == string::npos) {
+      continue;
+    }
+    Reader::Read(document, line);
+    return true;
+  }
+  return false;
+}
+
+const Value& CorpusReader::state() const {
+  return document["state"];
+}
+
+double CorpusReader::seconds() const {
+  const Value* seconds = document.Root().Find("seconds", 7);
+  return seconds ? seconds->AsNumber() : -1;
+}
+
+int CorpusReader::line_number() const {
+  return line_no;
+}
+
+string join_commands(const vector<string>& commands) {
+  string joined;
+  for (int i = 0; i < commands.size(); i++) {
+    if (i) joined += ' ';
+    joined += commands[i];
+  }
+  return joined;
+}
+
+void read_baseline(istream& in, vector<string>& lines) {
+  string line;
+  while (getline(in, line)) {
+    if (!line.empty() && line[line.size() - 1] == '\r') {
+      line.erase(line.size() - 1);
+    }
+    lines.push_back(line);
+  }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "dropblox_ai.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace json;
+using namespace std;
+
+// A corpus is a file of captured turns, one JSON object per line:
+//
+//   {"state": <game state, as passed to dropblox_ai>, "seconds": <float>}
+//
+// "seconds" is the time the AI had left when the state was captured and may be
+// missing. client.py appends to a corpus when DROPBLOX_CORPUS is set, and
+// ./simulate --record writes one.
+//
+// A baseline is a plain text file with one line per corpus record, holding the
+// commands chosen for that turn separated by spaces.
+
+// Writes `board`'s bitmap, current block and preview list in the server's
+// game state format, so the output can be fed straight back to dropblox_ai.
+void write_state(ostream& out, const Board& board);
+
+// Writes one corpus line for `board`. A negative `seconds` is left out.
+void write_record(ostream& out, const Board& board, double seconds);
+
+// Reads a corpus one record at a time, reusing a single Document so steady
+// state reading does not allocate.
+class CorpusReader {
+ public:
+  CorpusReader(istream& in);
+
+  // Advances to the next record. Returns false at the end of the corpus.
+  // Throws json::Exception on a malformed line.
+  bool next();
+
+  const Value& state() const;
+  // Negative if the record has no "seconds".
+  double seconds() const;
+  // 1-based line number of the current record.
+  int line_number() const;
+
+ private:
+  istream& in;
+  string line;
+  int line_no;
+  Document document;
+};
+
+string join_commands(const vector<string>& commands);
+
+// Reads a baseline file into one command line per record.
+void read_baseline(istream& in, vector<string>& lines);
@@ -5,14 +5,179 @@
 #include<cstring>
 #include <string.h>
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
 
 #include "dropblox_ai.h"
+#include "telemetry.h"
+#include "time_budget.h"
+#include "timers.h"
+#include "trace.h"
 
 using namespace json;
 using namespace std;
 
 #define INF 1000000000
 
+// The weights the engine ships with, as compile-time constants so get_score
+// can use an evaluator specialised for them (see score_with below).
+struct DefaultWeights {
+  static constexpr float holes = 20;
+  static constexpr float altitude = 1;
+  static constexpr float full_cells = 2;
+  static constexpr float higher_slope = 5;
+  static constexpr float roughness = 5;
+  static constexpr float full_cells_weighted = 0;
+  static constexpr float components = 10;
+};
+
+const float default_heuristic_params[NUM_FEATURES] = {
+  DefaultWeights::holes,
+  DefaultWeights::altitude,
+  DefaultWeights::full_cells,
+  DefaultWeights::higher_slope,
+  DefaultWeights::roughness,
+  DefaultWeights::full_cells_weighted,
+  DefaultWeights::components,
+};
+
+bool parse_heuristic_params(istream& in, float* params) {
+  int count = 0;
+  string token;
+  while (in >> token) {
+    if (token[0] == '#') {
+      getline(in, token);
+      continue;
+    }
+    stringstream fields(token);
+    string field;
+    while (getline(fields, field, ',')) {
+      if (field.empty()) continue;
+      char* end;
+      float value = strtof(field.c_str(), &end);
+      if (*end || count == NUM_FEATURES) return false;
+      params[count++] = value;
+    }
+  }
+  return count == NUM_FEATURES;
+}
+
+bool load_heuristic_params(const string& source, float* params) {
+  float loaded[NUM_FEATURES];
+  ifstream file(source.c_str());
+  bool ok;
+  if (file) {
+    ok = parse_heuristic_params(file, loaded);
+  } else {
+    istringstream text(source);
+    ok = parse_heuristic_params(text, loaded);
+  }
+  if (ok) memcpy(params, loaded, sizeof(loaded));
+  return ok;
+}
+
+//----------------------------------
+// Shape implementation starts here!
+//----------------------------------
+
+static bool point_less(const Point& a, const Point& b) {
+  return a.i != b.i ? a.i < b.i : a.j < b.j;
+}
+
+// Rotations keep the shape on the same grid around the center, so rotation
+// r + k covers the same cells as r exactly when the sorted cells match.
+static bool same_cells(const Point* a, const Point* b, int size) {
+  Point x[10], y[10];
+  memcpy(x, a, sizeof(Point) * size);
+  memcpy(y, b, sizeof(Point) * size);
+  sort(x, x + size, point_less);
+  sort(y, y + size, point_less);
+  for (int k = 0; k < size; k++) {
+    if (x[k].i != y[k].i || x[k].j != y[k].j) return false;
+  }
+  return true;
+}
+
+static Shape* build_shape(int id, const Point* offsets, int size) {
+  Shape* shape = new Shape();
+  shape->id = id;
+  shape->size = size;
+  memcpy(shape->offsets, offsets, sizeof(Point) * size);
+
+  for (int r = 0; r < 4; r++) {
+    Point* cells = shape->cells[r];
+    for (int k = 0; k < size; k++) {
+      if (r % 2) {
+        cells[k].i = (2 - r)*offsets[k].j;
+        cells[k].j = -(2 - r)*offsets[k].i;
+      } else {
+        cells[k].i = (1 - r)*offsets[k].i;
+        cells[k].j = (1 - r)*offsets[k].j;
+      }
+    }
+
+    shape->min_i[r] = shape->max_i[r] = cells[0].i;
+    shape->min_j[r] = shape->max_j[r] = cells[0].j;
+    for (int k = 1; k < size; k++) {
+      shape->min_i[r] = min(shape->min_i[r], cells[k].i);
+      shape->max_i[r] = max(shape->max_i[r], cells[k].i);
+      shape->min_j[r] = min(shape->min_j[r], cells[k].j);
+      shape->max_j[r] = max(shape->max_j[r], cells[k].j);
+    }
+    if (shape->max_i[r] - shape->min_i[r] < 10 &&
+        shape->max_j[r] - shape->min_j[r] < 32) {
+      for (int k = 0; k < size; k++) {
+        shape->row_masks[r][cells[k].i - shape->min_i[r]] |=
+            1u << (cells[k].j - shape->min_j[r]);
+      }
+    }
+
+    int count = 0;
+    for (int k = 0; k < size; k++) {
+      bool exposed = true;
+      for (int l = 0; l < size; l++) {
+        if (cells[l].j == cells[k].j && cells[l].i == cells[k].i + 1) exposed = false;
+      }
+      if (exposed) shape->bottom[r][count++] = cells[k];
+    }
+    shape->bottom_count[r] = count;
+  }
+
+  shape->symmetry = 4;
+  if (same_cells(shape->cells[0], shape->cells[1], size)) {
+    shape->symmetry = 1;
+  } else if (same_cells(shape->cells[0], shape->cells[2], size)) {
+    shape->symmetry = 2;
+  }
+  return shape;
+}
+
+static mutex shapes_lock;
+static unordered_map<string, const Shape*> shapes_by_key;
+
+const Shape* Shape::intern(const Point* offsets, int size) {
+  Point sorted[10];
+  memcpy(sorted, offsets, sizeof(Point) * size);
+  sort(sorted, sorted + size, point_less);
+  string key((const char*)sorted, sizeof(Point) * size);
+
+  lock_guard<mutex> guard(shapes_lock);
+  const Shape*& shape = shapes_by_key[key];
+  if (!shape) {
+    shape = build_shape(shapes_by_key.size() - 1, sorted, size);
+  }
+  return shape;
+}
+
+int Shape::count() {
+  lock_guard<mutex> guard(shapes_lock);
+  return shapes_by_key.size();
+}
+
 //----------------------------------
 // Block implementation starts here!
 //----------------------------------
@@ -31,6 +196,40 @@ Block::Block(Object& raw_block) {
     offsets[i].j = (Number&)raw_offsets[i]["j"];
   }
 
+  shape = Shape::intern(offsets, size);
+
+  translation.i = 0;
+  translation.j = 0;
+  rotation = 0;
+}
+
+Block::Block(const Value& raw_block) {
+  center.i = (int)raw_block["center"]["i"].AsNumber();
+  center.j = (int)raw_block["center"]["j"].AsNumber();
+
+  const Value& raw_offsets = raw_block["offsets"];
+  size = raw_offsets.Size();
+  for (int i = 0; i < size; i++) {
+    offsets[i].i = (int)raw_offsets[i]["i"].AsNumber();
+    offsets[i].j = (int)raw_offsets[i]["j"].AsNumber();
+  }
+
+  shape = Shape::intern(offsets, size);
+
+  translation.i = 0;
+  translation.j = 0;
+  rotation = 0;
+}
+
+Block::Block(const Point& center, const Point* offsets, int size) {
+  this->center = center;
+  this->size = size;
+  for (int i = 0; i < size; i++) {
+    this->offsets[i] = offsets[i];
+  }
+
+  shape = Shape::intern(offsets, size);
+
   translation.i = 0;
   translation.j = 0;
   rotation = 0;
@@ -52,12 +251,14 @@ void Block::down() {
   translation.i += 1;
 }
 
+// Rotations wrap around: the shape only has cells for rotation values 0
+// through 3.
 void Block::rotate() {
-  rotation += 1;
+  rotation = (rotation + 1) % 4;
 }
 
 void Block::unrotate() {
-  rotation -= 1;
+  rotation = (rotation + 3) % 4;
 }
 
 // The checked_* methods below perform an operation on the block
@@ -157,10 +358,23 @@ void Block::set_position(int a, int b, int c) {
 Board::Board() {
   rows = ROWS;
   cols = COLS;
+  memcpy(heuristic_params, default_heuristic_params, sizeof(heuristic_params));
+  deadline = INF;
+  timed_out = false;
+  queue = NULL;
+  queue_start = 0;
+  rows_cleared = 0;
 }
 
 Board::Board(Object& state) {
-  Board();
+  rows = ROWS;
+  cols = COLS;
+  memcpy(heuristic_params, default_heuristic_params, sizeof(heuristic_params));
+  deadline = INF;
+  timed_out = false;
+  queue = NULL;
+  queue_start = 0;
+  rows_cleared = 0;
 
   for (int i = 0; i < ROWS; i++) {
     for (int j = 0; j < COLS; j++) {
@@ -180,20 +394,56 @@ Board::Board(Object& state) {
   }
 }
 
-// Returns true if the `query` block is in valid position - that is, if all of
-// its squares are in bounds and are currently unoccupied.
-bool Board::check(const Block& query) const {
-  Point point;
-  for (int i = 0; i < query.size; i++) {
-    point.i = query.center.i + query.translation.i;
-    point.j = query.center.j + query.translation.j;
-    if (query.rotation % 2) {
-      point.i += (2 - query.rotation)*query.offsets[i].j;
-      point.j +=  -(2 - query.rotation)*query.offsets[i].i;
-    } else {
-      point.i += (1 - query.rotation)*query.offsets[i].i;
-      point.j += (1 - query.rotation)*query.offsets[i].j;
+Board::Board(const Value& state) {
+  rows = ROWS;
+  cols = COLS;
+  memcpy(heuristic_params, default_heuristic_params, sizeof(heuristic_params));
+  deadline = INF;
+  timed_out = false;
+  queue = NULL;
+  queue_start = 0;
+  rows_cleared = 0;
+
+  const Value& raw_bitmap = state["bitmap"];
+  for (int i = 0; i < ROWS; i++) {
+    const Value& raw_row = raw_bitmap[i];
+    for (int j = 0; j < COLS; j++) {
+      bitmap[i][j] = (raw_row[j].AsNumber() ? 1 : 0);
     }
+  }
+
+  // The same leak as above applies to these blocks.
+  block = new Block(state["block"]);
+  const Value& raw_preview = state["preview"];
+  for (int i = 0; i < PREVIEW_SIZE; i++) {
+    preview.push_back(new Block(raw_preview[i]));
+  }
+}
+
+Board::Board(const Bitmap& bitmap, Block* block, const vector<Block*>& preview) {
+  rows = ROWS;
+  cols = COLS;
+  memcpy(heuristic_params, default_heuristic_params, sizeof(heuristic_params));
+  deadline = INF;
+  timed_out = false;
+  queue = NULL;
+  queue_start = 0;
+  rows_cleared = 0;
+
+  memcpy(this->bitmap, bitmap, sizeof(Bitmap));
+  this->block = block;
+  this->preview = preview;
+}
+
+// Whether `shape`, turned to `rotation` with its center at (ci, cj), has all
+// of its squares in bounds and on empty cells of `bitmap`.
+static bool fits(const Bitmap& bitmap, const Shape* shape, int rotation,
+                 int ci, int cj) {
+  const Point* cells = shape->cells[rotation];
+  Point point;
+  for (int i = 0; i < shape->size; i++) {
+    point.i = ci + cells[i].i;
+    point.j = cj + cells[i].j;
     if (point.i < 0 || point.i >= ROWS ||
         point.j < 0 || point.j >= COLS || bitmap[point.i][point.j]) {
       return false;
@@ -202,6 +452,15 @@ bool Board::check(const Block& query) const {
   return true;
 }
 
+// Returns true if the `query` block is in valid position - that is, if all of
+// its squares are in bounds and are currently unoccupied.
+bool Board::check(const Block& query) const {
+  ScopedTimer timer(TIMER_CHECK);
+  return fits(bitmap, query.shape, query.rotation,
+              query.center.i + query.translation.i,
+              query.center.j + query.translation.j);
+}
+
 // Resets the block's position, moves it according to the given commands, then
 // drops it onto the board. Returns a pointer to the new board state object.
 //
@@ -232,70 +491,84 @@ Board* Board::do_commands(const vector<string>& commands) {
 // Assumes the block starts out in valid position.
 // This method translates the current block downwards.
 //
-// If there are no blocks left in the preview list, this method will fail badly!
-// This is okay because we don't expect to look ahead that far.
+// If there are no blocks left in the preview list, the new board's block is
+// NULL.
 Board* Board::place() {
-  Board* new_board = new Board();
-
   while (check(*block)) {
     block->down();
   }
   block->up();
 
-  for (int i = 0; i < ROWS; i++) {
-    for (int j = 0; j < COLS; j++) {
-      new_board->bitmap[i][j] = bitmap[i][j];
-    }
-  }
+  // The new board may outlive this one, so it gets its own preview list.
+  Board* new_board = place(posn(block->translation.i, block->translation.j,
+                                block->rotation));
+  new_board->preview.assign(new_board->queue->begin() + new_board->queue_start,
+                            new_board->queue->end());
+  new_board->queue = NULL;
+  new_board->queue_start = 0;
+  return new_board;
+}
 
-  Point point;
-  for (int i = 0; i < block->size; i++) {
-    point.i = block->center.i + block->translation.i;
-    point.j = block->center.j + block->translation.j;
-    if (block->rotation % 2) {
-      point.i += (2 - block->rotation)*block->offsets[i].j;
-      point.j +=  -(2 - block->rotation)*block->offsets[i].i;
-    } else {
-      point.i += (1 - block->rotation)*block->offsets[i].i;
-      point.j += (1 - block->rotation)*block->offsets[i].j;
-    }
-    new_board->bitmap[point.i][point.j] = 1;
+Board* Board::place(const posn& pos) const {
+  ScopedTimer timer(TIMER_PLACE);
+  Board* new_board = new Board();
+  memcpy(new_board->heuristic_params, heuristic_params, sizeof(heuristic_params));
+  new_board->deadline = deadline;
+
+  const Shape* shape = block->shape;
+  int ci = block->center.i + pos.tx;
+  int cj = block->center.j + pos.ty;
+  while (fits(bitmap, shape, pos.rot, ci, cj)) {
+    ci++;
   }
-  Board::remove_rows(&(new_board->bitmap));
+  ci--;
 
-  new_board->block = preview[0];
-  for (int i = 1; i < preview.size(); i++) {
-    new_board->preview.push_back(preview[i]);
+  memcpy(new_board->bitmap, bitmap, sizeof(Bitmap));
+  const Point* cells = shape->cells[pos.rot];
+  for (int i = 0; i < shape->size; i++) {
+    new_board->bitmap[ci + cells[i].i][cj + cells[i].j] = 1;
   }
+  // Only the rows the block landed in can have filled up.
+  int cleared[10];
+  new_board->rows_cleared = remove_rows(&new_board->bitmap, ci + shape->min_i[pos.rot],
+                                        ci + shape->max_i[pos.rot], cleared);
+
+  // Past the last preview block there is nothing to draw; see `block`.
+  const vector<Block*>& blocks = queue ? *queue : preview;
+  new_board->block = queue_start < blocks.size() ? blocks[queue_start] : NULL;
+  new_board->queue = &blocks;
+  new_board->queue_start = min(queue_start + 1, (int)blocks.size());
 
   return new_board;
 }
 
 // A static method that takes in a new_bitmap and removes any full rows from it.
 // Mutates the new_bitmap in place.
-void Board::remove_rows(Bitmap* new_bitmap) {
-  int rows_removed = 0;
-  for (int i = ROWS - 1; i >= 0; i--) {
-    bool full = true;
-    for (int j = 0; j < COLS; j++) {
-      if (!(*new_bitmap)[i][j]) {
-        full = false;
-        break;
-      }
-    }
-    if (full) {
-      rows_removed += 1;
-    } else if (rows_removed) {
-      for (int j = 0; j < COLS; j++) {
-        (*new_bitmap)[i + rows_removed][j] = (*new_bitmap)[i][j];
-      }
+int Board::remove_rows(Bitmap* new_bitmap) {
+  int cleared[ROWS];
+  return remove_rows(new_bitmap, 0, ROWS - 1, cleared);
+}
+
+int Board::remove_rows(Bitmap* new_bitmap, int first, int last, int* cleared) {
+  ScopedTimer timer(TIMER_REMOVE_ROWS);
+  Bitmap& bitmap = *new_bitmap;
+  int count = 0;
+  for (int i = max(first, 0); i <= min(last, ROWS - 1); i++) {
+    if (Masks::row_mask(bitmap[i]) == Masks::full_row()) {
+      cleared[count++] = i;
     }
   }
-  for (int i = 0; i < rows_removed; i++) {
-    for (int j = 0; j < COLS; j++) {
-      (*new_bitmap)[i][j] = 0;
-    }
+  if (!count) return 0;
+
+  // The rows between two cleared ones move down by the number of cleared
+  // rows below them, one block at a time. Starting from the bottom, each
+  // block only lands on rows that have already moved or been cleared.
+  for (int k = count - 1; k >= 0; k--) {
+    int top = k ? cleared[k - 1] + 1 : 0;
+    memmove(bitmap[top + count - k], bitmap[top], sizeof(bitmap[0]) * (cleared[k] - top));
   }
+  memset(bitmap, 0, sizeof(bitmap[0]) * count);
+  return count;
 }
 
 
@@ -306,97 +579,378 @@ bool operator<(const posn& a, const posn& b) {
 }
 
 
-void Board::generate_moves() {
-  vector<string> empty;
-  queue<int> Q;
-  int vis[100][100][4];
-  int SHIFT = 50;
-
-  int tx, ty, rot;
-  tx = ty = rot = 0;
-
-  memset(vis, -1, sizeof(vis));
-
-  Q.push(tx); Q.push(ty); Q.push(rot);
-
-  posn pos(tx, ty, rot);
-  commands[pos] = empty;
-
-  vis[tx + SHIFT][ty + SHIFT][rot] = 1;
-
-  while (!Q.empty()) {
-    tx = Q.front(); Q.pop();
-    ty = Q.front(); Q.pop();
-    rot = Q.front(); Q.pop();
-   
-    posn pos(tx, ty, rot);
-    vector<string> cmd;
-
-    cmd = commands[pos];
-    tx = pos.tx; ty = pos.ty; rot = pos.rot;
-    block->set_position(tx, ty, rot);
-    rot = (rot + 1) % 4;
-    block->rotate();
-    cmd.push_back("rotate");
-    if (check(*block) && vis[tx+SHIFT][ty+SHIFT][rot] == -1) {
-
-      vis[tx+SHIFT][ty+SHIFT][rot] = 1;
-      commands[posn(tx, ty, rot)] = cmd;
-      Q.push(tx); Q.push(ty); Q.push(rot);
+// Move generation works in a frame around the board, one row and column per
+// place the block's center can be, wide enough for every position whose
+// squares are on the board (a center is at most 9 from its squares) and the
+// moves off those positions.
+#define FRAME_MARGIN 10
+#define FRAME_ROWS (ROWS + 2*FRAME_MARGIN)
+#define FRAME_COLS (COLS + 2*FRAME_MARGIN)
+
+// A set of frame columns, as one mask per row of the frame.
+typedef MaskFor<FRAME_COLS>::type FrameRow;
+typedef MaskOps<FrameRow> FrameOps;
+
+// The commands generate_moves tries, in the order it tries them.
+static const char* move_names[5] = {"rotate", "right", "left", "down", "up"};
+
+// Bit y is set if board column y - FRAME_MARGIN is empty in a row whose
+// filled columns are `filled`.
+template <class Frame>
+static Frame empty_cells(const Masks::Row& filled) {
+  if constexpr (is_integral<Masks::Row>::value && is_integral<Frame>::value) {
+    return (Frame)(~filled & Masks::full_row()) << FRAME_MARGIN;
+  } else {
+    Frame empty = MaskOps<Frame>::low_bits(0);
+    for (int j = 0; j < COLS; j++) {
+      if (!Masks::RowOps::any(filled & Masks::RowOps::bit(j))) {
+        empty |= MaskOps<Frame>::bit(j + FRAME_MARGIN);
+      }
     }
+    return empty;
+  }
+}
 
-    cmd = commands[pos];
-    tx = pos.tx; ty = pos.ty; rot = pos.rot;
-    block->set_position(tx, ty, rot);
-    ty += 1;
-    block->right();
-    cmd.push_back("right");
-    if (check(*block) && vis[tx + SHIFT][ty + SHIFT][rot] == -1) {
-      vis[tx+SHIFT][ty+SHIFT][rot] = 1;
-      commands[posn(tx, ty, rot)] = cmd;
-      Q.push(tx); Q.push(ty); Q.push(rot);
+// The empty cells of a board with the given row masks, by frame row. The
+// margins have none.
+static void frame_rows(const Masks::Row* mask, FrameRow empty[FRAME_ROWS]) {
+  for (int x = 0; x < FRAME_ROWS; x++) {
+    int i = x - FRAME_MARGIN;
+    empty[x] = i >= 0 && i < ROWS ? empty_cells<FrameRow>(mask[i]) : FrameOps::low_bits(0);
+  }
+}
+
+// Bit y of valid[r][x] is set if the block, turned to rotation r with its
+// center in frame row x and column y, passes check(). Each square rules out
+// the centers that would put it on a filled or off-board cell, which is
+// the empty cells of its row shifted by its offset.
+static void find_valid(const FrameRow empty[FRAME_ROWS], const Shape* shape,
+                       FrameRow valid[4][FRAME_ROWS]) {
+  for (int r = 0; r < 4; r++) {
+    for (int x = 0; x < FRAME_ROWS; x++) {
+      FrameRow v = FrameOps::low_bits(FRAME_COLS);
+      for (int k = 0; k < shape->size && FrameOps::any(v); k++) {
+        const Point& square = shape->cells[r][k];
+        int row = x + square.i;
+        if (row < 0 || row >= FRAME_ROWS) {
+          v = FrameOps::low_bits(0);
+        } else if (square.j >= 0) {
+          v &= FrameOps::shr(empty[row], square.j);
+        } else {
+          v &= FrameOps::shl(empty[row], -square.j);
+        }
+      }
+      valid[r][x] = v;
     }
+  }
+}
 
-    cmd = commands[pos];
-    tx = pos.tx; ty = pos.ty; rot = pos.rot;
-    block->set_position(tx, ty, rot);
-    ty -= 1;
-    block->left();
-    cmd.push_back("left");
-    if (check(*block) && vis[tx+SHIFT][ty+SHIFT][rot] == -1) {
-      vis[tx+SHIFT][ty+SHIFT][rot] = 1;
-      commands[posn(tx, ty, rot)] = cmd;
-      Q.push(tx); Q.push(ty); Q.push(rot);
+// Fills reach[r][x] with the positions that commands can take the block to
+// from (0, x0, y0), the spawn position, which counts as reached even if it is
+// not valid. Moves within a row are a spread over that row's valid
+// positions; down, up and rotate carry a row's positions to the next row or
+// rotation. Sweeping the rows down and then up carries most of the block's
+// travel in one round, and rounds repeat until nothing changes.
+static void flood_fill(const FrameRow valid[4][FRAME_ROWS], int x0, int y0,
+                       FrameRow reach[4][FRAME_ROWS]) {
+  for (int r = 0; r < 4; r++) {
+    for (int x = 0; x < FRAME_ROWS; x++) {
+      reach[r][x] = FrameOps::low_bits(0);
     }
+  }
+  reach[0][x0] = FrameOps::bit(y0);
+
+  // No position in the first or last frame row is valid.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (int sweep = 0; sweep < 2; sweep++) {
+      for (int n = 1; n < FRAME_ROWS - 1; n++) {
+        int x = sweep ? FRAME_ROWS - 1 - n : n;
+        for (int r = 0; r < 4; r++) {
+          FrameRow from = reach[r][x - 1] | reach[r][x + 1] | reach[(r + 3) % 4][x];
+          FrameRow seed = reach[r][x] | (from & valid[r][x]);
+          FrameRow spread = FrameOps::spread(seed, valid[r][x]);
+          if (!(spread == reach[r][x])) {
+            reach[r][x] = spread;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+}
 
-    cmd = commands[pos];
-    tx = pos.tx; ty = pos.ty; rot = pos.rot;
-    block->set_position(tx, ty, rot);
-    tx += 1;
-    block->down();
-    cmd.push_back("down");
-    if (check(*block) && vis[tx+SHIFT][ty+SHIFT][rot] == -1) {
-      vis[tx+SHIFT][ty+SHIFT][rot] = 1;
-      commands[posn(tx, ty, rot)] = cmd;
-      Q.push(tx); Q.push(ty); Q.push(rot);
+// Lists the placements of a block spawning at frame (x0, y0) from where it
+// can reach, as generate_moves describes. Every reachable position drops to
+// the bottom of its run of reachable positions in the same column and
+// rotation, so each run is one placement, represented by its top. Rotations
+// that cover the same squares as a lower one only add the runs the lower
+// one cannot reach.
+static void list_placements(const FrameRow reach[4][FRAME_ROWS], const Shape* shape,
+                            int x0, int y0, vector<posn>& placements) {
+  placements.clear();
+  for (int r = 0; r < 4; r++) {
+    for (int x = 1; x < FRAME_ROWS; x++) {
+      FrameRow tops = reach[r][x] & ~reach[r][x - 1];
+      for (int same = r - shape->symmetry; same >= 0; same -= shape->symmetry) {
+        tops &= ~reach[same][x];
+      }
+      for (; FrameOps::any(tops); FrameOps::clear_lowest(tops)) {
+        placements.push_back(posn(x - x0, FrameOps::lowest(tops) - y0, r));
+      }
+    }
+  }
+  sort(placements.begin(), placements.end());
+}
+
+#define FRAME_NODES (FRAME_ROWS * FRAME_COLS * 4)
+
+// Breadth-first search over valid positions from `spawn`, trying moves in
+// move_names order, so the path it finds to each position is the first
+// shortest one. A node is (x * FRAME_COLS + y) * 4 + r. Each reached node
+// gets its predecessor in `from` (-1 if not reached) and the move from it in
+// `move`, and `queue` lists the nodes in the order reached. Returns the
+// number of nodes reached.
+static int search_paths(const FrameRow valid[4][FRAME_ROWS], int spawn,
+                        vector<int>& from, vector<char>& move, vector<int>& queue) {
+  from.assign(FRAME_NODES, -1);
+  move.resize(FRAME_NODES);
+  queue.resize(FRAME_NODES);
+  int head = 0, tail = 0;
+  from[spawn] = spawn;
+  queue[tail++] = spawn;
+
+  while (head < tail) {
+    int at = queue[head++];
+    TELEMETRY(telemetry.positions++);
+    int r = at % 4, y = at / 4 % FRAME_COLS, x = at / 4 / FRAME_COLS;
+    int next_x[5] = {x, x, x, x + 1, x - 1};
+    int next_y[5] = {y, y + 1, y - 1, y, y};
+    int next_r[5] = {(r + 1) % 4, r, r, r, r};
+    for (int m = 0; m < 5; m++) {
+      if (!FrameOps::any(valid[next_r[m]][next_x[m]] & FrameOps::bit(next_y[m]))) {
+        continue;
+      }
+      int next = (next_x[m] * FRAME_COLS + next_y[m]) * 4 + next_r[m];
+      TELEMETRY(if (from[next] != -1) telemetry.dup_hits++);
+      if (from[next] == -1) {
+        from[next] = at;
+        move[next] = m;
+        queue[tail++] = next;
+      }
     }
+  }
+  return tail;
+}
+
+// The node commands_for ends the path to `top`, a run top in frame
+// coordinates, at: the highest node of the run that the search did not
+// reach by moving down or up, which has the shortest commands.
+static int path_end(const vector<char>& move, int spawn, int top) {
+  int at = top;
+  while (at != spawn && move[at] >= 3) {
+    at += FRAME_COLS * 4;
+  }
+  return at;
+}
 
-    cmd = commands[pos];
-    tx = pos.tx; ty = pos.ty; rot = pos.rot;
-    block->set_position(tx, ty, rot);
-    tx -= 1;
-    block->up();
-    cmd.push_back("up");
-    if (check(*block) && vis[tx+SHIFT][ty+SHIFT][rot] == -1) {
-
-      vis[tx+SHIFT][ty+SHIFT][rot] = 1;
-      commands[posn(tx, ty, rot)] = cmd;
-      Q.push(tx); Q.push(ty); Q.push(rot);
+// The moves for a block on an empty board. A board has the same placements,
+// and commands_for finds the same paths to them, if its top `clear_rows`
+// rows are empty and the block fits into none of its cavities (see
+// generate_moves). That covers most boards in a game, so these are worked
+// out once per shape and spawn point and shared.
+struct OpenMoves {
+  int clear_rows;
+  vector<posn> placements;
+};
+
+// Works out `moves` for `block` on an empty board. The placements and their
+// paths depend on the search out to each run's top and the positions below
+// it down to where its path ends. Another board whose valid positions agree
+// with the empty board's out to one more move than the farthest of them
+// searches the same way that far, so it has the same run tops and paths.
+// Valid positions never cover filled cells, so it is enough that the rows
+// those positions cover are empty there too.
+static void find_open_moves(const Block& block, OpenMoves& moves) {
+  const Shape* shape = block.shape;
+  int x0 = block.center.i + FRAME_MARGIN;
+  int y0 = block.center.j + FRAME_MARGIN;
+  Masks::Row mask[ROWS];
+  for (int i = 0; i < ROWS; i++) {
+    mask[i] = Masks::RowOps::low_bits(0);
+  }
+  FrameRow empty[FRAME_ROWS], valid[4][FRAME_ROWS], reach[4][FRAME_ROWS];
+  frame_rows(mask, empty);
+  find_valid(empty, shape, valid);
+  flood_fill(valid, x0, y0, reach);
+  list_placements(reach, shape, x0, y0, moves.placements);
+
+  if (!FrameOps::any(valid[0][x0] & FrameOps::bit(y0))) {
+    moves.clear_rows = ROWS + 1;
+    return;
+  }
+  vector<int> from, queue;
+  vector<char> move;
+  int spawn = (x0 * FRAME_COLS + y0) * 4;
+  int reached = search_paths(valid, spawn, from, move, queue);
+  vector<int> dist(FRAME_NODES);
+  dist[spawn] = 0;
+  for (int k = 1; k < reached; k++) {
+    dist[queue[k]] = dist[from[queue[k]]] + 1;
+  }
+
+  int farthest = 0;
+  for (int k = 0; k < moves.placements.size(); k++) {
+    const posn& pos = moves.placements[k];
+    int top = ((pos.tx + x0) * FRAME_COLS + pos.ty + y0) * 4 + pos.rot;
+    int end = path_end(move, spawn, top);
+    for (int at = top; at <= end; at += FRAME_COLS * 4) {
+      farthest = max(farthest, dist[at]);
     }
+  }
+  moves.clear_rows = 0;
+  for (int k = 0; k < reached && dist[queue[k]] <= farthest + 1; k++) {
+    int at = queue[k];
+    int lowest = at / 4 / FRAME_COLS - FRAME_MARGIN + shape->max_i[at % 4];
+    moves.clear_rows = max(moves.clear_rows, lowest + 1);
+  }
+}
 
+static mutex open_moves_lock;
+static map<pair<const Shape*, pair<int, int> >, const OpenMoves*> open_moves_by_block;
+
+static const OpenMoves* open_moves_for(const Block& block) {
+  pair<const Shape*, pair<int, int> > key(
+      block.shape, make_pair(block.center.i, block.center.j));
+  lock_guard<mutex> guard(open_moves_lock);
+  const OpenMoves*& moves = open_moves_by_block[key];
+  if (!moves) {
+    OpenMoves* found = new OpenMoves();
+    find_open_moves(block, *found);
+    moves = found;
   }
+  return moves;
+}
 
-  block->reset_position();
+void Board::generate_moves() {
+  TELEMETRY(double start = omp_get_wtime());
+  TELEMETRY(telemetry.generate_calls++);
+  const Shape* shape = block->shape;
+  Masks::Row mask[ROWS];
+  Masks::row_masks(bitmap, mask);
+  FrameRow empty[FRAME_ROWS], valid[4][FRAME_ROWS];
+  frame_rows(mask, empty);
+  bool have_valid = false;
+
+  // Filling every cavity (an empty cell below a filled one in its column)
+  // leaves a board where every valid position is above the stack, in a
+  // column and rotation it shares with the empty board. If that changes no
+  // valid position, and the rows the empty board's search looked at are
+  // empty, this board's placements are the empty board's.
+  const OpenMoves* open_moves = open_moves_for(*block);
+  bool open = open_moves->clear_rows <= ROWS;
+  for (int i = 0; open && i < open_moves->clear_rows; i++) {
+    open = !Masks::RowOps::any(mask[i]);
+  }
+  if (open) {
+    Masks::Row filled[ROWS];
+    Masks::Row above = Masks::RowOps::low_bits(0);
+    bool cavities = false;
+    for (int i = 0; i < ROWS; i++) {
+      above |= mask[i];
+      filled[i] = above;
+      cavities |= !(above == mask[i]);
+    }
+    if (cavities) {
+      FrameRow filled_empty[FRAME_ROWS], filled_valid[4][FRAME_ROWS];
+      frame_rows(filled, filled_empty);
+      find_valid(empty, shape, valid);
+      find_valid(filled_empty, shape, filled_valid);
+      have_valid = true;
+      open = !memcmp(valid, filled_valid, sizeof(valid));
+    }
+  }
+
+  if (open) {
+    TELEMETRY(telemetry.open_boards++);
+    placements = open_moves->placements;
+  } else {
+    FrameRow reach[4][FRAME_ROWS];
+    if (!have_valid) find_valid(empty, shape, valid);
+    int x0 = block->center.i + FRAME_MARGIN;
+    int y0 = block->center.j + FRAME_MARGIN;
+    flood_fill(valid, x0, y0, reach);
+    list_placements(reach, shape, x0, y0, placements);
+  }
+  TELEMETRY(telemetry.generate_moves += omp_get_wtime() - start);
+}
+
+vector<string> Board::commands_for(const posn& pos) {
+  int x0 = block->center.i + FRAME_MARGIN;
+  int y0 = block->center.j + FRAME_MARGIN;
+  Masks::Row mask[ROWS];
+  Masks::row_masks(bitmap, mask);
+  FrameRow empty[FRAME_ROWS], valid[4][FRAME_ROWS];
+  frame_rows(mask, empty);
+  find_valid(empty, block->shape, valid);
+
+  vector<int> from, queue;
+  vector<char> move;
+  int spawn = (x0 * FRAME_COLS + y0) * 4;
+  search_paths(valid, spawn, from, move, queue);
+
+  vector<string> path;
+  int top = ((pos.tx + x0) * FRAME_COLS + pos.ty + y0) * 4 + pos.rot;
+  if (from[top] == -1) return path;
+  for (int at = path_end(move, spawn, top); at != spawn; at = from[at]) {
+    path.push_back(move_names[move[at]]);
+  }
+  reverse(path.begin(), path.end());
+  return path;
+}
+
+int Board::count_positions(bool by_search, unsigned long long* hash,
+                           vector<posn>* placements) {
+  int x0 = block->center.i + FRAME_MARGIN;
+  int y0 = block->center.j + FRAME_MARGIN;
+  Masks::Row mask[ROWS];
+  Masks::row_masks(bitmap, mask);
+  FrameRow empty[FRAME_ROWS], valid[4][FRAME_ROWS], reach[4][FRAME_ROWS];
+  frame_rows(mask, empty);
+  find_valid(empty, block->shape, valid);
+
+  if (by_search) {
+    vector<int> from, queue;
+    vector<char> move;
+    search_paths(valid, (x0 * FRAME_COLS + y0) * 4, from, move, queue);
+    for (int r = 0; r < 4; r++) {
+      for (int x = 0; x < FRAME_ROWS; x++) {
+        reach[r][x] = FrameOps::low_bits(0);
+        for (int y = 0; y < FRAME_COLS; y++) {
+          if (from[(x * FRAME_COLS + y) * 4 + r] != -1) reach[r][x] |= FrameOps::bit(y);
+        }
+      }
+    }
+  } else {
+    flood_fill(valid, x0, y0, reach);
+  }
+
+  // FNV-1a over the positions in (rotation, row, column) order.
+  int count = 0;
+  unsigned long long h = 1469598103934665603ULL;
+  for (int r = 0; r < 4; r++) {
+    for (int x = 0; x < FRAME_ROWS; x++) {
+      for (FrameRow row = reach[r][x]; FrameOps::any(row); FrameOps::clear_lowest(row)) {
+        int position = (r * FRAME_ROWS + x) * FRAME_COLS + FrameOps::lowest(row);
+        h = (h ^ (unsigned)position) * 1099511628211ULL;
+        count++;
+      }
+    }
+  }
+  if (hash) *hash = h;
+  if (placements) list_placements(reach, block->shape, x0, y0, *placements);
+  return count;
 }
 
 void Board::print_moves(vector<string>& moves) {
@@ -406,365 +960,325 @@ void Board::print_moves(vector<string>& moves) {
 
 
 void Board::choose_move(int depth) {
+  TELEMETRY(double start = omp_get_wtime());
   min_score = INF;
+  runner_up_score = INF;
+  nodes = 0;
+  timed_out = false;
 
   vector<pair<float, posn> > scores;
+  FeatureCache cache;
+  cache_features(cache);
 
-  for (map<posn, vector<string> >::iterator it = commands.begin();
-    it != commands.end(); it++) {
-    posn pos = it -> first;
-    vector<string> moves = it -> second;
-
-    if (moves.size() > 0 && (moves.back() == "down" || 
-          moves.back() == "up")) continue;
-
-    block->set_position(pos);
-    Board* new_board = place();
-
-    float score = get_score(new_board->bitmap);
+  for (int k = 0; k < placements.size(); k++) {
+    posn pos = placements[k];
+    float score = score_placement(cache, pos);
 
     scores.push_back(make_pair(score, pos));
   }
+  nodes += scores.size();
+  TELEMETRY(telemetry.evaluations += scores.size());
 
+  // Equal scores go to the lower posn, which is the top of the placement's
+  // run (see generate_moves), so ties do not depend on how it is reached.
   sort(scores.begin(), scores.end());
 
   if (depth == 0) {
-    best = commands[scores[0].second];
+    best_placement = scores[0].second;
     this -> min_score = scores[0].first;
+    if (scores.size() > 1) runner_up_score = scores[1].first;
+    TELEMETRY(if (depth < TELEMETRY_MAX_DEPTH)
+                telemetry.choose_move[depth] += omp_get_wtime() - start);
     return ;
   }
 
-  for (int i = 0; i < scores.size() && i < 25 ; i++) {
-    posn pos = scores[i].second;
+  // Only the SEARCH_WIDTH best placements are searched further; the rest
+  // are pruned.
+  TELEMETRY(telemetry.candidates += scores.size());
+  TELEMETRY(telemetry.expanded += min((int)scores.size(), SEARCH_WIDTH));
+  TELEMETRY(telemetry.pruned += max((int)scores.size() - SEARCH_WIDTH, 0));
 
-    block->set_position(pos);
-    Board* new_board = place();
+  for (int i = 0; i < scores.size() && i < SEARCH_WIDTH; i++) {
+    if (deadline != INF && omp_get_wtime() > deadline) {
+      timed_out = true;
+      break;
+    }
+    posn pos = scores[i].second;
+    Board* new_board = place(pos);
 
-    new_board->generate_moves();
-    new_board->choose_move(depth - 1);
+    {
+      TraceSpan span("generate_moves", depth - 1, i);
+      new_board->generate_moves();
+    }
+    {
+      TraceSpan span("choose_move", depth - 1, i);
+      new_board->choose_move(depth - 1);
+    }
+    nodes += new_board->nodes;
+    if (new_board->timed_out) {
+      timed_out = true;
+      delete new_board;
+      break;
+    }
 
     if (new_board -> min_score < min_score) {
+      runner_up_score = min_score;
       min_score = new_board -> min_score;
-      best = commands[pos];
+      best_placement = pos;
+    } else if (new_board->min_score < runner_up_score) {
+      runner_up_score = new_board->min_score;
     }
+    delete new_board;
 
   }
+  TELEMETRY(if (depth < TELEMETRY_MAX_DEPTH)
+              telemetry.choose_move[depth] += omp_get_wtime() - start);
 }
 
+void Board::search(int depth) {
+  {
+    TraceSpan span("generate_moves", depth);
+    generate_moves();
+  }
+  {
+    TraceSpan span("choose_move", depth);
+    choose_move(depth);
+  }
+  best = commands_for(best_placement);
+}
+
+int Board::search(int max_depth, double deadline) {
+  {
+    TraceSpan span("generate_moves", 0);
+    generate_moves();
+  }
+  this->deadline = deadline;
+  posn chosen;
+  int depth = 0;
+  for (int d = 0; d <= max_depth; d++) {
+    double start = omp_get_wtime();
+    {
+      TraceSpan span("choose_move", d);
+      choose_move(d);
+    }
+    // Depth 0 never checks the clock, so there is always a move.
+    if (timed_out) break;
+    chosen = best_placement;
+    depth = d;
+
+    double now = omp_get_wtime();
+    if (runner_up_score - min_score > DOMINANT_MARGIN * fabs(min_score)) break;
+    // The next depth searches up to SEARCH_WIDTH boards like this one.
+    if (now + (now - start) * SEARCH_WIDTH > deadline) break;
+  }
+  this->deadline = INF;
+  timed_out = false;
+  best = commands_for(chosen);
+  return depth;
+}
+
+// The features below work on each row's occupancy mask and most also on each
+// column's top filled row; see board_masks.h.
 int Board::count_holes(Bitmap& newState) 
 {
+  ScopedTimer timer(TIMER_COUNT_HOLES);
   // A cell is a hole if it is empty but somewhere above it, there is
-  // block or part of a block.
-  int row, col, has_ceiling;
-  unsigned int hole_count = 0;
-  for (col = 0; col < COLS; col++) {
-    has_ceiling = 0;
-    for (row = 0; row < ROWS; row++) {
-      if ((newState[row][col] == 0) &&
-         (has_ceiling == 1)) {
-          hole_count++;
-      }
-      if (newState[row][col] != 0) {
-          has_ceiling = 1;
-      }
-    }
+  // block or part of a block. Every filled cell sits at or below its
+  // column's top, so whatever else lies between the top and the floor is a
+  // hole.
+  Masks::Row mask[ROWS];
+  int top[COLS];
+  Masks::row_masks(newState, mask);
+  Masks::column_tops(mask, top);
+  int hole_count = 0;
+  for (int j = 0; j < COLS; j++) {
+    hole_count += ROWS - top[j];
+  }
+  for (int i = 0; i < ROWS; i++) {
+    hole_count -= Masks::cells(mask[i]);
   }
   return hole_count;
 }
 
 int Board::altitude(Bitmap &newState) {
+  ScopedTimer timer(TIMER_ALTITUDE);
   int res = 0;
-  for (int i = ROWS - 1; i >= 0; i--){
-    bool success = false;
-    for (int j = 0; j < COLS; j++) {
-      if (newState[i][j]) {
-        success = true;
-        break;
-      }
-    }
-
-    if (success) {
-         res++;
-    } else {
-      break;
-    }
+  while (res < ROWS && Masks::RowOps::any(Masks::row_mask(newState[ROWS - 1 - res]))) {
+    res++;
   }
   return res;
 }
 
-int dirX[] = {-1, 0, 0, 1};
-int dirY[] = {0, 1, -1, 0};
-
-inline
-bool sameColor(int x1, int y1, int x2, int y2, Bitmap &newState) {
-  if (newState[x1][y1] == 0 && newState[x2][y2] == 0)
-    return true;
-
-  if (newState[x1][y1] != 0 && newState[x2][y2] != 0)
-    return true;
-
-  return false;
-}
-
-void dfs(Bitmap &newState, int x, int y, vector< vector<bool> > &visited) {
-
-  if (visited[x][y])
-    return;
-
-  visited[x][y] = true;
-  for (int i = 0; i < 4; i++) {
-    int newX = x + dirX[i];
-    int newY = y + dirY[i];
-    if (newX < 0 || newX >= ROWS || newY < 0 || newY >= COLS) {
-      continue;
-    }
-
-    if (sameColor(newX, newY, x, y, newState)) {
-      dfs(newState, newX, newY, visited);
-    }
-  }
-}
 int Board::countComponents(Bitmap &newState) {
-
-  int res = 0;
-  vector< vector<bool> > visited(ROWS, vector<bool>(COLS, false));
-
-  for (int i = 0; i < ROWS; i++) {
-    for (int j = 0; j < COLS; j++) {
-      if (visited[i][j])
-        continue;
-      // cout << i << "\t" << j << endl;
-      res++;
-      dfs(newState, i, j, visited);
-    }
-  }
-  return res;
+  ScopedTimer timer(TIMER_COUNT_COMPONENTS);
+  Masks::Row mask[ROWS];
+  Masks::row_masks(newState, mask);
+  return Masks::count_components(mask);
 }
 
 int Board::roughness(Bitmap &newState) {
-     int row, col, has_ceiling = 0;
-     unsigned int sum_height = 0;
-  
-     for (col = 0; col < COLS; col++) {
-          for (row = 0; row < ROWS; row++) {
-               if (newState[row][col] != 0) {
-                    unsigned int height_left = 0;
-                    unsigned int height_right = 0;
-
-                    // No ceiling on left
-                    int row_iter = row;
-                    if (col-1 >= 0) {
-                         has_ceiling = 0;
-                         for (int i = row_iter - 1; i >= 0; i--) {
-                              if (newState[i][col-1] != 0) {
-                                   has_ceiling = 1;
-                                   break;
-                              }
-                         }
-                    
-                         if (! has_ceiling) {
-                              while (row_iter < ROWS &&
-                                     newState[row_iter++][col-1] == 0) {
-                                   height_left++;
-                              }
-                         }
-                    }
-                    
-                    
-
-                    if (col+1 < COLS) {
-                         row_iter = row;
-                         has_ceiling = 0;
-                         for (int i = row_iter - 1; i >= 0; i--) {
-                              if (newState[i][col+1] != 0) {
-                                   has_ceiling = 1;
-                                   break;
-                              }
-                         }
-                         if (! has_ceiling) {
-                              while (row_iter < ROWS &&
-                                     newState[row_iter++][col+1] == 0) {
-                                   height_right++;
-                              }
-                         }
-                    }
-                    
-                    sum_height += (height_right + height_left);
-                    break;
-               }
-          }
-     }
-     return sum_height;
+  ScopedTimer timer(TIMER_ROUGHNESS);
+  Masks::Row mask[ROWS];
+  int top[COLS], sum, largest;
+  Masks::row_masks(newState, mask);
+  Masks::column_tops(mask, top);
+  Masks::slopes(top, &sum, &largest);
+  return sum;
 }
 
 int Board::full_cells(Bitmap& newState) {
+  ScopedTimer timer(TIMER_FULL_CELLS);
   int count = 0;
   for (int i = 0; i < ROWS; i++) {
-    for (int j = 0; j < COLS; j++) {
-      if (newState[i][j] != 0) count++;
-    }
+    count += Masks::cells(Masks::row_mask(newState[i]));
   }
   return count;
 }
 
 int Board::higher_slope(Bitmap& newState)
 {
-     int row, col, has_ceiling = 0;
-     unsigned int max_height = 0;
-  
-     for (col = 0; col < COLS; col++) {
-          for (row = 0; row < ROWS; row++) {
-               if (newState[row][col] != 0) {
-                    unsigned int height_left = 0;
-                    unsigned int height_right = 0;
-
-                    // No ceiling on left
-                    int row_iter = row;
-                    if (col-1 >= 0) {
-                         has_ceiling = 0;
-                         for (int i = row_iter - 1; i >= 0; i--) {
-                              if (newState[i][col-1] != 0) {
-                                   has_ceiling = 1;
-                                   break;
-                              }
-                         }
-                    
-                         if (! has_ceiling) {
-                              while (row_iter < ROWS &&
-                                     newState[row_iter++][col-1] == 0) {
-                                   height_left++;
-                              }
-                         }
-                    }
-                    
-                    
-
-                    if (col+1 < COLS) {
-                         row_iter = row;
-                         has_ceiling = 0;
-                         for (int i = row_iter - 1; i >= 0; i--) {
-                              if (newState[i][col+1] != 0) {
-                                   has_ceiling = 1;
-                                   break;
-                              }
-                         }
-                         if (! has_ceiling) {
-                              while (row_iter < ROWS &&
-                                     newState[row_iter++][col+1] == 0) {
-                                   height_right++;
-                              }
-                         }
-                    }
-                    
-                    
-           
-                    max_height = max (max_height, height_right);
-                    max_height = max (max_height, height_left);
-                    break;
-               }
-          }
-     }
-     return max_height;
+  ScopedTimer timer(TIMER_HIGHER_SLOPE);
+  Masks::Row mask[ROWS];
+  int top[COLS], sum, largest;
+  Masks::row_masks(newState, mask);
+  Masks::column_tops(mask, top);
+  Masks::slopes(top, &sum, &largest);
+  return largest;
 }
 
 int Board::full_cells_weighted(Bitmap& newState) {
+  ScopedTimer timer(TIMER_FULL_CELLS_WEIGHTED);
   int count = 0;
   for (int i = 0; i < ROWS; i++) {
-    for (int j = 0; j < COLS; j++) {
-      if (newState[i][j] != 0) count += ROWS-i;
-    }
+    count += Masks::cells(Masks::row_mask(newState[i])) * (ROWS - i);
   }
   return count;
 }
 
-float Board::get_score(Bitmap& newState) {
-  float score = 0.0;
+void Board::features(Bitmap& newState, int* out) {
+  Masks::Row mask[ROWS];
+  int top[COLS];
+  Masks::row_masks(newState, mask);
+  Masks::column_tops(mask, top);
+  Masks::features(mask, top, out);
+}
+
+void Board::cache_features(FeatureCache& cache) {
+  Masks::row_masks(bitmap, cache.mask);
+  Masks::column_tops(cache.mask, cache.top);
+  Masks::features(cache.mask, cache.top, cache.values);
+  Masks::column_masks(cache.mask, cache.column);
+}
+
+float Board::score_placement(const FeatureCache& cache, const posn& pos) {
+  ScopedTimer timer(TIMER_SCORE_PLACEMENT);
+  const Shape* shape = block->shape;
+  int rotation = pos.rot;
+  int ci = block->center.i + pos.tx;
+  int cj = block->center.j + pos.ty;
+  Point points[10];
+  for (int i = 0; i < shape->size; i++) {
+    points[i].i = ci + shape->cells[rotation][i].i;
+    points[i].j = cj + shape->cells[rotation][i].j;
+  }
+
+  // The block falls until one of its squares is right above a filled cell
+  // or the floor, which the column masks give directly. Only squares with
+  // none of the block right below them can land first.
+  int drop = ROWS;
+  for (int i = 0; i < shape->bottom_count[rotation]; i++) {
+    const Point& square = shape->bottom[rotation][i];
+    drop = min(drop, Masks::fall(cache.column, ci + square.i, cj + square.j));
+  }
+
+  Masks::Row mask[ROWS];
+  int top[COLS];
+  memcpy(mask, cache.mask, sizeof(mask));
+  memcpy(top, cache.top, sizeof(top));
+  int cells = cache.values[2] + shape->size;
+  int weighted = cache.values[5];
+  int rows[10];
+
+  for (int i = 0; i < shape->size; i++) {
+    Point point = points[i];
+    point.i += drop;
+    rows[i] = point.i;
+    mask[point.i] |= Masks::RowOps::bit(point.j);
+    top[point.j] = min(top[point.j], point.i);
+    weighted += ROWS - point.i;
+  }
+
+  // Clearing rows moves everything above them, so rescore from scratch.
+  for (int i = 0; i < shape->size; i++) {
+    if (mask[rows[i]] == Masks::full_row()) {
+      Board* new_board = place(pos);
+      float score = get_score(new_board->bitmap);
+      delete new_board;
+      return score;
+    }
+  }
 
-  float params[] = {20, 1, 2, 5, 5, 0, 10};
+  // Rows only gain cells, so the bottom run of non-empty rows can only grow.
+  int values[NUM_FEATURES];
+  int holes = -cells;
+  for (int j = 0; j < COLS; j++) {
+    holes += ROWS - top[j];
+  }
+  int altitude = cache.values[1];
+  while (altitude < ROWS && Masks::RowOps::any(mask[ROWS - 1 - altitude])) {
+    altitude++;
+  }
+  values[0] = holes;
+  values[1] = altitude;
+  values[2] = cells;
+  Masks::slopes(top, &values[4], &values[3]);
+  values[5] = weighted;
 
-  score += params[0]*count_holes(newState);
-  score += params[1]*altitude(newState);
-  score += params[2]*full_cells(newState);
-  score += params[3]*higher_slope(newState);
-  score += params[4]*roughness(newState);
-  //score += params[5]*full_cells_weighted(newState);
-  score += params[6]*countComponents(newState);
+  // Summed exactly as get_score does, so the scores are bit-identical.
+  float score = 0.0;
+  float* params = heuristic_params;
+  for (int k = 0; k < NUM_FEATURES - 1; k++) {
+    if (params[k]) score += params[k]*values[k];
+  }
+  if (params[6]) score += params[6]*Masks::count_components(mask);
   return score;
 }
 
-int test () 
-{Bitmap bitmap = {
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8},
-            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8},
-            {1, 1, 0, 4, 0, 2, 2, 0, 0, 0, 0, 9},
-            {0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8},
-     };
-     cout << Board::count_holes (bitmap) << endl;
-     cout << Board::altitude (bitmap) << endl;
-     cout << Board::full_cells (bitmap) << endl;
-     cout << Board::higher_slope (bitmap) << endl;
-     cout << Board::roughness (bitmap) << endl;
-     cout << Board::full_cells_weighted (bitmap) << endl;
-     cout << Board::countComponents (bitmap) << endl;
-
-     return 0;
-}
-
-int main(int argc, char** argv) {
-     // test ();
-     // return 0;
-
-  // Construct a JSON Object with the given game state.
-  istringstream raw_state(argv[1]);
-  Object state;
-  Reader::Read(state, raw_state);
-
-  // Construct a board from this Object.
-  Board board(state);
-
-  board.generate_moves();
-  board.choose_move(1);
-
-  board.print_moves(board.best);
-
-  // // Make some moves!
-  // vector<string> moves;
-  // while (board.check(*board.block)) {
-  //   board.block->left();
-  //   moves.push_back("left");
-  // }
-  // // Ignore the last move, because it moved the block into invalid
-  // // position. Make all the rest.
-  // for (int i = 0; i < moves.size() - 1; i++) {
-  //   cout << moves[i] << endl;
-  // }
+// get_score for a weight set known at compile time. Zero-weight features are
+// compiled out, and the sum is taken in the same order as the generic path so
+// both give bit-identical scores.
+template <class Weights>
+static float score_with(Bitmap& newState) {
+  float score = 0.0;
+  if (Weights::holes) score += Weights::holes*Board::count_holes(newState);
+  if (Weights::altitude) score += Weights::altitude*Board::altitude(newState);
+  if (Weights::full_cells) score += Weights::full_cells*Board::full_cells(newState);
+  if (Weights::higher_slope) score += Weights::higher_slope*Board::higher_slope(newState);
+  if (Weights::roughness) score += Weights::roughness*Board::roughness(newState);
+  if (Weights::full_cells_weighted) {
+    score += Weights::full_cells_weighted*Board::full_cells_weighted(newState);
+  }
+  if (Weights::components) score += Weights::components*Board::countComponents(newState);
+  return score;
+}
+
+float Board::get_score(Bitmap& newState) {
+  ScopedTimer timer(TIMER_GET_SCORE);
+  if (!memcmp(heuristic_params, default_heuristic_params, sizeof(heuristic_params))) {
+    return score_with<DefaultWeights>(newState);
+  }
+
+  float score = 0.0;
+
+  float* params = heuristic_params;
+
+  // Features with a zero weight are not computed at all.
+  if (params[0]) score += params[0]*count_holes(newState);
+  if (params[1]) score += params[1]*altitude(newState);
+  if (params[2]) score += params[2]*full_cells(newState);
+  if (params[3]) score += params[3]*higher_slope(newState);
+  if (params[4]) score += params[4]*roughness(newState);
+  if (params[5]) score += params[5]*full_cells_weighted(newState);
+  if (params[6]) score += params[6]*countComponents(newState);
+  return score;
 }
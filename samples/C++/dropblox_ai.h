@@ -1,4 +1,7 @@
+#pragma once
+
 #include "omp.h"
+#include "board_masks.h"
 #include "json/reader.h"
 #include "json/elements.h"
 
@@ -8,17 +11,58 @@
 using namespace json;
 using namespace std;
 
+// The board's dimensions. The defaults are the competition's; building with
+// e.g. -DROWS=40 -DCOLS=20 runs the engine on another size, and the
+// dimension-dependent code in board_masks.h is instantiated to match.
+#ifndef ROWS
 #define ROWS 33
+#endif
+#ifndef COLS
 #define COLS 12
+#endif
+#ifndef PREVIEW_SIZE
 #define PREVIEW_SIZE 5
+#endif
+
+// How many plies choose_move looks ahead on a real turn without a clock.
+#define SEARCH_DEPTH 1
+// The deepest any search may go; the preview has one block per ply. Tools
+// that take a depth reject anything deeper.
+#define MAX_SEARCH_DEPTH PREVIEW_SIZE
+// choose_move searches only this many of a board's best placements further.
+#define SEARCH_WIDTH 25
 
 typedef int Bitmap[ROWS][COLS];
 
+typedef BoardMasks<ROWS, COLS> Masks;
+
+// get_score is a weighted sum of this many features, in the order: holes,
+// altitude, full cells, higher slope, roughness, weighted full cells and
+// connected components.
+#define NUM_FEATURES 7
+
+// The weights every board starts with.
+extern const float default_heuristic_params[NUM_FEATURES];
+
+// Reads NUM_FEATURES weights, separated by spaces, commas or newlines, into
+// `params`. Text from a '#' to the end of its line is a comment, so weight
+// files written by ./tune parse as is. Returns false, leaving `params` alone,
+// unless there are exactly NUM_FEATURES numbers.
+bool parse_heuristic_params(istream& in, float* params);
+
+// Loads weights from `source`, which is either the name of a weight file or
+// the weights themselves, e.g. "20,1,2,5,5,0,10".
+bool load_heuristic_params(const string& source, float* params);
+
 struct posn {
   int tx;
   int ty;
   int rot;
 
+  posn() {
+    tx = ty = rot = 0;
+  }
+
   posn(int a, int b, int c) {
     tx = a; ty = b; rot = c;
   }
@@ -26,12 +70,59 @@ struct posn {
 
 class Board;
 
+// A board's row occupancy masks (bit j set if column j is filled), column
+// occupancy masks (bit i set if row i is filled, plus bit ROWS for the
+// floor), column tops (first filled row, ROWS if empty) and feature values,
+// kept so that each placement on the board can be scored from what the piece
+// changes.
+struct FeatureCache {
+  Masks::Row mask[ROWS];
+  Masks::Column column[COLS];
+  int top[COLS];
+  int values[NUM_FEATURES];
+};
+
 class Point {
  public:
   int i;
   int j;
 };
 
+// Everything about a piece that depends only on its offsets, worked out once
+// per distinct shape and shared by every block with that shape. The game
+// deals from a small set of shapes, so after the first few turns of a
+// process building a block costs a table lookup. Shapes are immutable and
+// live until the process exits.
+struct Shape {
+  // Index in the order shapes were first seen.
+  int id;
+  int size;
+  // The offsets sorted by (i, j), and cells[r] the same offsets turned by
+  // rotation r as check() and place() turn them.
+  Point offsets[10];
+  Point cells[4][10];
+  // Bounding box of cells[r].
+  int min_i[4], max_i[4], min_j[4], max_j[4];
+  // Bit k of row_masks[r][i] is set if cells[r] includes
+  // (min_i[r] + i, min_j[r] + k), for the max_i[r] - min_i[r] + 1 rows of
+  // the bounding box. Empty when the box is wider than a mask.
+  unsigned row_masks[4][10];
+  // The cells of cells[r] with no cell of the shape right below them. A drop
+  // is decided by these alone; a shape with a gap in a column has more than
+  // one in it, since the board can reach into the gap.
+  int bottom_count[4];
+  Point bottom[4][10];
+  // Number of distinct rotations: 1, 2 or 4. Rotations r and r + symmetry
+  // cover the same cells.
+  int symmetry;
+
+  // Returns the shared shape for these offsets, in any order, building it
+  // the first time. Safe to call from several threads.
+  static const Shape* intern(const Point* offsets, int size);
+  // Number of shapes interned so far.
+  static int count();
+};
+
 class Block {
  public:
   // The size of a block is the number of squares in the block.
@@ -44,8 +135,12 @@ class Block {
   // the value "rotation".
   Point translation;
   int rotation;
+  // The interned shape for `offsets`.
+  const Shape* shape;
 
   Block(Object& raw_block);
+  Block(const Value& raw_block);
+  Block(const Point& center, const Point* offsets, int size);
   void left();
   void right();
   void up();
@@ -80,19 +175,51 @@ class Block {
 class Board {
  public:
   vector<string> best;
+  // The placement the last choose_move picked; search() turns it into `best`.
+  posn best_placement;
   float min_score;
+  // The score of the best placement other than best_placement, or INF if
+  // there is none.
+  float runner_up_score;
+  // Number of placements scored by the last choose_move, including the
+  // subtrees it searched.
+  long long nodes;
+  // choose_move gives up once omp_get_wtime() is past this, leaving
+  // `timed_out` set and its results incomplete. Boards start with no
+  // deadline; boards made by place() and do_commands() inherit theirs.
+  double deadline;
+  bool timed_out;
 
-  map<posn, vector<string> > commands;
+  // Filled by generate_moves: one position per place the block can come to
+  // rest, the highest reachable one that drops there, in posn order. Only the
+  // positions are worked out; commands_for finds the commands for one.
+  vector<posn> placements;
 
   int rows;
   int cols;
   Bitmap bitmap;
+  // The number of rows the drop that made this board cleared; 0 for boards
+  // built from a game state.
+  int rows_cleared;
+  // The search never moves `block` or any preview block; it works with
+  // posn values instead, so boards can share their blocks freely. NULL on a
+  // board placed after the last preview block, which a search at
+  // MAX_SEARCH_DEPTH scores but never generates moves for.
   Block* block;
+  // Boards made by place(pos) during a search leave this empty and share
+  // their parent's list instead; see `queue`.
   vector<Block*> preview;
 
   Board(Object& state);
+  Board(const Value& state);
+  // Builds a board directly from a bitmap, without going through JSON. The
+  // board does not take ownership of the blocks.
+  Board(const Bitmap& bitmap, Block* block, const vector<Block*>& preview);
 
-  float heuristic_params[6];
+  // Weights for get_score, one per feature. Constructors start from
+  // default_heuristic_params, and boards made by place() and do_commands()
+  // inherit their parent's weights.
+  float heuristic_params[NUM_FEATURES];
 
   // Returns true if the `query` block is in valid position - that is, if all of
   // its squares are in bounds and are currently unoccupied.
@@ -113,13 +240,40 @@ class Board {
   // Assumes the block starts out in valid position.
   // This method translates the current block downwards.
   //
-  // If there are no blocks left in the preview list, this method will fail badly!
-  // This is okay because we don't expect to look ahead that far.
+  // If there are no blocks left in the preview list, the new board's block is
+  // NULL.
   Board* place();
+  // The same for the block at `pos`, without moving it. The new board reads
+  // its preview from this board's instead of copying it, so it must not
+  // outlive this board; the search uses it for the boards it looks ahead on.
+  Board* place(const posn& pos) const;
 
   void print_moves(vector<string>&);
   void generate_moves();
+  // The commands that take the block to `pos`, one of `placements`: a
+  // shortest path there, found by searching this board's positions.
+  vector<string> commands_for(const posn& pos);
+  // The number of positions the block can reach from its spawn position,
+  // counting the spawn position itself, as generate_moves finds them with
+  // by_search false and as commands_for's search finds them with it true.
+  // If `hash` is not NULL, it gets a hash of the set of positions, which
+  // the two should agree on too, and if `placements` is not NULL, the
+  // placements those positions give, which should be generate_moves'. For
+  // checking move generation; see move_counts.h.
+  int count_positions(bool by_search, unsigned long long* hash,
+                      vector<posn>* placements);
+  // Scores the placements, searching the given number of pieces further, and
+  // leaves the best in `best_placement` and its score in `min_score`.
   void choose_move(int);
+  // Everything the AI does for one turn: generates this board's moves and
+  // searches them to the given depth, leaving the chosen commands in `best`.
+  void search(int depth);
+  // The same against a clock: searches to depth 0, then 1 and so on up to
+  // `max_depth` while the next depth looks like it will finish by
+  // `deadline` (an omp_get_wtime() time), stopping early once one placement
+  // is clearly best. A depth cut off by the deadline is thrown away.
+  // Returns the depth `best` comes from.
+  int search(int max_depth, double deadline);
   // h0 = the number of holes in the playfield
   static int count_holes(Bitmap& newState);
   // h1 = height of the higest point
@@ -135,12 +289,40 @@ class Board {
 
   static int countComponents(Bitmap &newState);
 
+  // Computes all NUM_FEATURES features above in a single pass over the
+  // bitmap, in heuristic_params order, into out[0..NUM_FEATURES). The values
+  // are the same as calling each feature function on its own.
+  static void features(Bitmap& newState, int* out);
+
   float get_score(Bitmap& newState);
 
+  // Fills `cache` for this board's bitmap.
+  void cache_features(FeatureCache& cache);
+
+  // Drops the block from `pos`, as place(pos) does, and returns what
+  // get_score would give the resulting board. The score is updated from
+  // `cache` (which must be for this board) and the cells the block lands on,
+  // without building the new board. Drops that clear rows fall back to
+  // place(pos) and get_score.
+  float score_placement(const FeatureCache& cache, const posn& pos);
+
   // A static method that takes in a new_bitmap and removes any full rows from it.
-  // Mutates the new_bitmap in place.
-  static void remove_rows(Bitmap* new_bitmap);
+  // Mutates the new_bitmap in place. Returns the number of rows removed.
+  static int remove_rows(Bitmap* new_bitmap);
+  // The same, looking only at rows `first` through `last`, which is enough
+  // after a drop that filled cells in those rows only. The removed rows'
+  // indices (before the removal, in increasing order) go to `cleared`, which
+  // needs room for last - first + 1 of them.
+  static int remove_rows(Bitmap* new_bitmap, int first, int last, int* cleared);
  
  private:
   Board();
+
+  // The preview list of a board made by place(pos): its parent's list, or
+  // the one it shares, from index `queue_start` on. NULL for boards that
+  // keep their own in `preview`. Nothing keeps that list alive, so a board
+  // made by place(pos) must be deleted before its parent; place() gives the
+  // board it returns its own list for that reason.
+  const vector<Block*>* queue;
+  int queue_start;
 };
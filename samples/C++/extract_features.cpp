@@ -0,0 +1,186 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "corpus.h"
+#include "feature_file.h"
+#include "simulator.h"
+
+using namespace std;
+
+// Writes the get_score features of many boards to a binary columnar feature
+// file (see feature_file.h). Usage:
+//
+//   ./extract_features OUT (--corpus FILE | --games N) [--afterstates]
+//                      [--chunk C] [--threads T] [--seed S] [--depth D]
+//                      [--max-pieces P] [--min-size A] [--max-size B]
+//                      [--weights W]
+//
+// Boards come from a recorded corpus, or from N simulated games played with
+// the simulator options (game i uses seed S + i). --afterstates writes a row
+// for every placement the search would score rather than one per state.
+//
+// States are processed C at a time (default 1024): each chunk is expanded
+// and featurised across all cores, written out and freed, so memory stays
+// bounded however large the input is. Simulated games are played a few per
+// core at a time, since each one holds its whole record until it ends.
+
+void usage(const char* name) {
+  cerr << "usage: " << name << " OUT (--corpus FILE | --games N)"
+       << " [--afterstates] [--chunk C] [--threads T] [--seed S] [--depth D]"
+       << " [--max-pieces P] [--min-size A] [--max-size B] [--weights W]"
+       << endl;
+  exit(1);
+}
+
+class ChunkedExtractor {
+ public:
+  ChunkedExtractor(FeatureWriter& writer, bool afterstates, int chunk)
+      : states(0), writer(writer), afterstates(afterstates), chunk(chunk) {
+  }
+
+  void add(const Value& state) {
+    boards.push_back(new Board(state));
+    if (boards.size() >= chunk) flush();
+  }
+
+  void flush() {
+    if (boards.empty()) return;
+    extract_features(boards, afterstates, sources, rows);
+    writer.write(sources, rows, states);
+    states += boards.size();
+    for (int b = 0; b < boards.size(); b++) {
+      delete boards[b]->block;
+      for (int k = 0; k < boards[b]->preview.size(); k++) {
+        delete boards[b]->preview[k];
+      }
+      delete boards[b];
+    }
+    boards.clear();
+  }
+
+  long long states;
+
+ private:
+  FeatureWriter& writer;
+  bool afterstates;
+  int chunk;
+  vector<Board*> boards;
+  vector<int> sources;
+  vector<int> rows;
+};
+
+// Feeds every record of a corpus stream to `extractor`.
+void add_corpus(istream& in, const char* name, ChunkedExtractor& extractor) {
+  CorpusReader reader(in);
+  try {
+    while (reader.next()) {
+      extractor.add(reader.state());
+    }
+  } catch (json::Exception& e) {
+    cerr << name << ":" << reader.line_number() << ": " << e.what() << endl;
+    exit(1);
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) usage(argv[0]);
+  const char* out_path = argv[1];
+  const char* corpus_path = NULL;
+  int games = 0;
+  bool afterstates = false;
+  int chunk = 1024;
+  unsigned long long seed = 1;
+  SimConfig config;
+  config.record = true;
+
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--afterstates")) {
+      afterstates = true;
+      continue;
+    }
+    if (i + 1 >= argc) usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(argv[i - 1], "--corpus")) {
+      corpus_path = value;
+    } else if (!strcmp(argv[i - 1], "--games")) {
+      games = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--chunk")) {
+      chunk = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--threads")) {
+      omp_set_num_threads(atoi(value));
+    } else if (!strcmp(argv[i - 1], "--seed")) {
+      seed = strtoull(value, NULL, 10);
+    } else if (!strcmp(argv[i - 1], "--depth")) {
+      config.depth = atoi(value);
+      if (config.depth < 0 || config.depth > MAX_SEARCH_DEPTH) {
+        cerr << "--depth must be between 0 and " << MAX_SEARCH_DEPTH << endl;
+        return 1;
+      }
+    } else if (!strcmp(argv[i - 1], "--max-pieces")) {
+      config.max_pieces = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--min-size")) {
+      config.min_piece_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--max-size")) {
+      config.max_piece_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--weights")) {
+      if (!load_heuristic_params(value, config.params)) {
+        cerr << "bad weights: " << value << endl;
+        return 1;
+      }
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if ((corpus_path == NULL) == (games <= 0) || chunk <= 0 ||
+      config.min_piece_size < 1 || config.max_piece_size > 10 ||
+      config.min_piece_size > config.max_piece_size) {
+    usage(argv[0]);
+  }
+
+  ofstream out(out_path, ios::binary);
+  if (!out) {
+    cerr << "cannot write " << out_path << endl;
+    return 1;
+  }
+  FeatureWriter writer(out);
+  ChunkedExtractor extractor(writer, afterstates, chunk);
+  double start = omp_get_wtime();
+
+  if (corpus_path) {
+    ifstream in(corpus_path);
+    if (!in) {
+      cerr << "cannot open " << corpus_path << endl;
+      return 1;
+    }
+    add_corpus(in, corpus_path, extractor);
+  } else {
+    Simulator simulator(config);
+    int batch = 4 * omp_get_max_threads();
+    for (int first = 0; first < games; first += batch) {
+      vector<unsigned long long> seeds;
+      for (int i = first; i < games && i < first + batch; i++) {
+        seeds.push_back(seed + i);
+      }
+      vector<GameResult> results;
+      simulator.play_many(seeds, results);
+      for (int i = 0; i < results.size(); i++) {
+        istringstream record(results[i].record);
+        add_corpus(record, "simulated game", extractor);
+      }
+    }
+  }
+  extractor.flush();
+
+  if (!out.flush()) {
+    cerr << "error writing " << out_path << endl;
+    return 1;
+  }
+  double elapsed = omp_get_wtime() - start;
+  printf("%lld states, %lld rows in %.2fs (%.0f rows/s)\n", extractor.states,
+         writer.rows_written, elapsed, writer.rows_written / elapsed);
+  return 0;
+}
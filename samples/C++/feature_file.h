@@ -0,0 +1,51 @@
+#pragma once
+
+#include "dropblox_ai.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Bulk extraction of the get_score features, for fitting evaluators offline.
+//
+// Feature files are binary and columnar, little-endian throughout:
+//
+//   header:  the 8 bytes "DBXFEAT\0", uint32 version (1), uint32 columns,
+//            then for each column its name (NUL-terminated) and a uint8
+//            width in bytes (2 or 4)
+//   chunks:  uint32 rows (never 0), then each column in header order as
+//            `rows` signed integers of the column's width
+//
+// A file ends after its last chunk. The columns are "state", the index of the
+// source game state in input order (int32), followed by one int16 column per
+// feature named as in feature_names.
+
+extern const char* feature_names[NUM_FEATURES];
+
+// Computes features for a batch of boards across all cores. Without
+// `afterstates` each board yields one row for its own bitmap. With it, each
+// board yields one row for every placement of its current block that
+// choose_move would score, i.e. the boards get_score actually sees.
+//
+// `rows` receives NUM_FEATURES values per row, and `sources` the index in
+// `boards` each row came from; rows are in board order. The boards'
+// placement lists are used as scratch.
+void extract_features(const vector<Board*>& boards, bool afterstates,
+                      vector<int>& sources, vector<int>& rows);
+
+class FeatureWriter {
+ public:
+  // Writes the file header.
+  FeatureWriter(ostream& out);
+
+  // Writes one chunk. `sources` and `rows` are as filled in by
+  // extract_features; `first_state` is added to each source index.
+  void write(const vector<int>& sources, const vector<int>& rows,
+             long long first_state);
+
+  long long rows_written;
+
+ private:
+  ostream& out;
+};
@@ -0,0 +1,96 @@
+#include <cstring>
+
+#include "feature_file.h"
+
+const char* feature_names[NUM_FEATURES] = {
+  "holes",
+  "altitude",
+  "full_cells",
+  "higher_slope",
+  "roughness",
+  "full_cells_weighted",
+  "components",
+};
+
+void extract_features(const vector<Board*>& boards, bool afterstates,
+                      vector<int>& sources, vector<int>& rows) {
+  int n = boards.size();
+  vector<vector<int> > per_board(n);
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int b = 0; b < n; b++) {
+    Board* board = boards[b];
+    vector<int>& out = per_board[b];
+    if (!afterstates) {
+      out.resize(NUM_FEATURES);
+      Board::features(board->bitmap, &out[0]);
+      continue;
+    }
+
+    // The same placements choose_move scores.
+    board->generate_moves();
+    for (int k = 0; k < board->placements.size(); k++) {
+      Board* child = board->place(board->placements[k]);
+      out.resize(out.size() + NUM_FEATURES);
+      Board::features(child->bitmap, &out[out.size() - NUM_FEATURES]);
+      delete child;
+    }
+  }
+
+  sources.clear();
+  rows.clear();
+  for (int b = 0; b < n; b++) {
+    rows.insert(rows.end(), per_board[b].begin(), per_board[b].end());
+    sources.insert(sources.end(), per_board[b].size() / NUM_FEATURES, b);
+  }
+}
+
+//-----------------------------------------
+// FeatureWriter implementation starts here!
+//-----------------------------------------
+
+static void put(ostream& out, long long value, int width) {
+  char bytes[4];
+  for (int k = 0; k < width; k++) {
+    bytes[k] = (char)((value >> (8 * k)) & 0xff);
+  }
+  out.write(bytes, width);
+}
+
+FeatureWriter::FeatureWriter(ostream& out) : rows_written(0), out(out) {
+  out.write("DBXFEAT\0", 8);
+  put(out, 1, 4);
+  put(out, 1 + NUM_FEATURES, 4);
+  out.write("state", 6);
+  put(out, 4, 1);
+  for (int k = 0; k < NUM_FEATURES; k++) {
+    out.write(feature_names[k], strlen(feature_names[k]) + 1);
+    put(out, 2, 1);
+  }
+}
+
+void FeatureWriter::write(const vector<int>& sources, const vector<int>& rows,
+                          long long first_state) {
+  int count = sources.size();
+  if (!count) return;
+
+  // Columns are staged whole so each goes out in a single write.
+  vector<char> column(4 * count);
+  put(out, count, 4);
+  for (int r = 0; r < count; r++) {
+    long long state = first_state + sources[r];
+    for (int k = 0; k < 4; k++) {
+      column[4 * r + k] = (char)((state >> (8 * k)) & 0xff);
+    }
+  }
+  out.write(&column[0], 4 * count);
+  for (int f = 0; f < NUM_FEATURES; f++) {
+    for (int r = 0; r < count; r++) {
+      int value = rows[r * NUM_FEATURES + f];
+      column[2 * r] = (char)(value & 0xff);
+      column[2 * r + 1] = (char)((value >> 8) & 0xff);
+    }
+    out.write(&column[0], 2 * count);
+  }
+  rows_written += count;
+}
@@ -0,0 +1,73 @@
+#include "fixtures.h"
+
+const Fixture fixtures[] = {
+  {"empty", {
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............"}},
+  {"midgame", {
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "..X.........", "..XX......X.", ".XXXX....XX.",
+    "XXXXXX..XXX.", "XXXXXXX.XXXX", "XXXX.XXXXXXX", "XXXXXXXXXX.X",
+    "XXXXXXXXXXXX"}},
+  {"ragged", {
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "............", "............", "............", "............",
+    "X...........", "XX.......X..", "XX..X....XX.", "XXX.XX..XXX.",
+    "X.X.XX..X.X.", "X.XXXX.XX.XX", "XXX.X..XXX.X", "X.XXX.XX.XXX",
+    "XXXX..XXXXX.", ".XXXXXXX.XXX", "XX.XXX.XXXXX", "XXXXX.XXXX.X",
+    "X.XXXXXXXXXX", "XXXX.XXXXXXX", "XXXXXXXXXXXX", "XXXXXXXXXX.X",
+    "XXXXXXXXXXXX"}},
+};
+
+const int num_fixtures = sizeof(fixtures) / sizeof(fixtures[0]);
+
+const int shapes[][4][2] = {
+  {{0, 0}, {0, -1}, {0, 1}, {-1, 0}},   // T
+  {{0, 0}, {0, -1}, {0, 1}, {-1, 1}},   // L
+  {{0, 0}, {0, -1}, {0, 1}, {0, 2}},    // I
+  {{0, 0}, {0, -1}, {-1, 0}, {-1, 1}},  // S
+  {{0, 0}, {0, 1}, {-1, 0}, {-1, 1}},   // O
+  {{0, 0}, {0, 1}, {-1, 0}, {-1, -1}},  // Z
+};
+
+const char* shape_names[NUM_SHAPES] = {"T", "L", "I", "S", "O", "Z"};
+
+Block* make_block(int shape) {
+  Point center;
+  center.i = 1;
+  center.j = COLS / 2 - 1;
+  Point offsets[4];
+  for (int k = 0; k < 4; k++) {
+    offsets[k].i = shapes[shape][k][0];
+    offsets[k].j = shapes[shape][k][1];
+  }
+  return new Block(center, offsets, 4);
+}
+
+Board* make_board(const Fixture& fixture, int shape) {
+  Bitmap bitmap;
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      bitmap[i][j] = (fixture.rows[i][j] == 'X');
+    }
+  }
+  vector<Block*> preview;
+  for (int k = 1; k <= PREVIEW_SIZE; k++) {
+    preview.push_back(make_block((shape + k) % NUM_SHAPES));
+  }
+  return new Board(bitmap, make_block(shape), preview);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "dropblox_ai.h"
+
+// Fixed boards and pieces shared by the bench and perft tools. The boards are
+// drawn for the competition's 33x12 board.
+
+// Rows are listed top to bottom; 'X' is a filled cell.
+struct Fixture {
+  const char* name;
+  const char* rows[ROWS];
+};
+
+extern const Fixture fixtures[];
+extern const int num_fixtures;
+
+#define NUM_SHAPES 6
+
+// Tetrominoes, as (i, j) offsets from the center square.
+extern const int shapes[NUM_SHAPES][4][2];
+extern const char* shape_names[NUM_SHAPES];
+
+// A block of the given shape at the spawn point.
+Block* make_block(int shape);
+
+// A board with the fixture's cells, a block of the given shape and the
+// shapes after it in the preview. The caller owns the blocks.
+Board* make_board(const Fixture& fixture, int shape = 0);
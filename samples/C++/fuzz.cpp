@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#include "corpus.h"
+#include "reference.h"
+#include "simulator.h"
+
+using namespace std;
+
+// Differential fuzzing of the engine against the reference model in
+// reference.h. Usage:
+//
+//   ./fuzz [--cases N] [--seed S] [--min-size A] [--max-size B] [--threads T]
+//
+// Case i is a random board and piece drawn from seed S + i. On it, check,
+// remove_rows (both forms), the heuristics, get_score, the placements from
+// generate_moves, place, score_placement, commands_for and choose_move must
+// all agree exactly with the reference. The first failing case is shrunk, by
+// clearing cells and dropping squares of the piece while the same check still
+// fails, and printed as a picture and as a game state for dropblox_ai; the
+// exit status is then 1.
+
+void usage(const char* name) {
+  cerr << "usage: " << name << " [--cases N] [--seed S] [--min-size A]"
+       << " [--max-size B] [--threads T]" << endl;
+  exit(1);
+}
+
+struct Case {
+  Bitmap bitmap;
+  Point center;
+  vector<Point> offsets;
+  float params[NUM_FEATURES];
+  // Drives the positions check() is probed at and the rows remove_rows is
+  // given, so that a shrunk case probes the same way.
+  unsigned long long probe_seed;
+};
+
+// Random stacks with holes, near-full rows and floating cells, in the mix the
+// engine's fast paths have special cases for: the empty board, boards with
+// clear rows up top and drops that clear rows.
+void random_board(Rng& rng, Bitmap& bitmap) {
+  memset(bitmap, 0, sizeof(Bitmap));
+  int kind = rng.below(5);
+  if (kind == 0) return;
+
+  int base = rng.below(ROWS * 3 / 4);
+  int holes = rng.below(40);
+  for (int j = 0; j < COLS; j++) {
+    int height = max(0, min(ROWS - 4, base + rng.below(9) - 4));
+    for (int i = ROWS - height; i < ROWS; i++) {
+      bitmap[i][j] = rng.below(100) >= holes;
+    }
+  }
+  if (kind == 2 || kind == 4) {
+    // Rows one or two cells short of full.
+    int count = 1 + rng.below(4);
+    for (int k = 0; k < count; k++) {
+      int i = ROWS - 1 - rng.below(max(1, base + 1));
+      for (int j = 0; j < COLS; j++) bitmap[i][j] = 1;
+      for (int gaps = 1 + rng.below(2); gaps; gaps--) {
+        bitmap[i][rng.below(COLS)] = 0;
+      }
+    }
+  }
+  if (kind == 3 || kind == 4) {
+    // Overhangs and floating cells, below a few clear rows.
+    int density = 1 + rng.below(15);
+    for (int i = 4; i < ROWS; i++) {
+      for (int j = 0; j < COLS; j++) {
+        if (rng.below(100) < density) bitmap[i][j] = 1;
+      }
+    }
+  }
+
+  // A game never leaves a full row on the board, and place(pos) relies on it.
+  for (int i = 0; i < ROWS; i++) {
+    bool full = true;
+    for (int j = 0; j < COLS; j++) full = full && bitmap[i][j];
+    if (full) bitmap[i][rng.below(COLS)] = 0;
+  }
+}
+
+Case make_case(unsigned long long seed, int min_size, int max_size) {
+  Rng rng(seed);
+  Case c;
+  random_board(rng, c.bitmap);
+
+  PieceGenerator pieces(rng.next(), min_size, max_size);
+  Block* block = pieces.next();
+  c.center = block->center;
+  c.offsets.assign(block->offsets, block->offsets + block->size);
+  delete block;
+
+  // Half the cases score with the default weights, which get_score has a
+  // separate path for.
+  memcpy(c.params, default_heuristic_params, sizeof(c.params));
+  if (rng.below(2)) {
+    for (int k = 0; k < NUM_FEATURES; k++) {
+      c.params[k] = rng.below(3) ? rng.below(41) - 10 : 0;
+    }
+  }
+  c.probe_seed = rng.next();
+  return c;
+}
+
+string describe(const Cells& cells) {
+  ostringstream out;
+  for (size_t k = 0; k < cells.size(); k++) {
+    out << (k ? " " : "") << "(" << cells[k].first << "," << cells[k].second << ")";
+  }
+  return out.str();
+}
+
+string describe(const posn& pos) {
+  ostringstream out;
+  out << "(" << pos.tx << ", " << pos.ty << ", " << pos.rot << ")";
+  return out.str();
+}
+
+// The first difference between `bitmap` and `expected`, or "".
+string compare_bitmaps(const Bitmap& bitmap, const Bitmap& expected) {
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      if (!bitmap[i][j] != !expected[i][j]) {
+        ostringstream out;
+        out << "cell (" << i << "," << j << ") is " << !!bitmap[i][j]
+            << ", reference " << !!expected[i][j];
+        return out.str();
+      }
+    }
+  }
+  return "";
+}
+
+// Each check is named by the text up to its first ':', which shrinking keeps
+// fixed.
+#define FAIL(message)        \
+  {                          \
+    ostringstream out;       \
+    out << message;          \
+    return out.str();        \
+  }
+
+string check_features(Board& board, Bitmap& bitmap) {
+  int expected[NUM_FEATURES], fused[NUM_FEATURES];
+  ref_features(bitmap, expected);
+  int single[NUM_FEATURES] = {
+    Board::count_holes(bitmap), Board::altitude(bitmap), Board::full_cells(bitmap),
+    Board::higher_slope(bitmap), Board::roughness(bitmap),
+    Board::full_cells_weighted(bitmap), Board::countComponents(bitmap),
+  };
+  Board::features(bitmap, fused);
+  for (int k = 0; k < NUM_FEATURES; k++) {
+    if (single[k] != expected[k]) {
+      FAIL("feature " << k << ": " << single[k] << ", reference " << expected[k]);
+    }
+    if (fused[k] != expected[k]) {
+      FAIL("features: feature " << k << " is " << fused[k] << ", reference "
+           << expected[k]);
+    }
+  }
+  float score = board.get_score(bitmap);
+  float reference = ref_score(bitmap, board.heuristic_params);
+  if (score != reference) {
+    FAIL("get_score: " << score << ", reference " << reference);
+  }
+  return "";
+}
+
+string check_remove_rows(const Case& c, Rng& rng) {
+  Bitmap bitmap, expected;
+  memcpy(bitmap, c.bitmap, sizeof(Bitmap));
+  for (int count = rng.below(5); count; count--) {
+    int i = rng.below(ROWS);
+    for (int j = 0; j < COLS; j++) bitmap[i][j] = 1;
+  }
+  memcpy(expected, bitmap, sizeof(Bitmap));
+
+  // Only rows in the range count, as after a drop.
+  int first = rng.below(ROWS);
+  int last = min(ROWS - 1, first + rng.below(10));
+  int cleared[10];
+  vector<int> expected_cleared;
+  int removed = Board::remove_rows(&bitmap, first, last, cleared);
+  int expected_removed = ref_remove_rows(expected, first, last, &expected_cleared);
+  if (removed != expected_removed ||
+      !equal(cleared, cleared + removed, expected_cleared.begin())) {
+    FAIL("remove_rows " << first << ".." << last << ": removed " << removed
+         << ", reference " << expected_removed);
+  }
+  string diff = compare_bitmaps(bitmap, expected);
+  if (!diff.empty()) FAIL("remove_rows " << first << ".." << last << ": " << diff);
+
+  removed = Board::remove_rows(&bitmap);
+  expected_removed = ref_remove_rows(expected, 0, ROWS - 1, NULL);
+  if (removed != expected_removed) {
+    FAIL("remove_rows: removed " << removed << ", reference " << expected_removed);
+  }
+  diff = compare_bitmaps(bitmap, expected);
+  if (!diff.empty()) FAIL("remove_rows: " << diff);
+  return "";
+}
+
+string check_check(const Board& board, const Block& spawn, Rng& rng) {
+  for (int probe = 0; probe < 64; probe++) {
+    Block block = spawn;
+    block.set_position(rng.below(ROWS + 6) - 3 - spawn.center.i,
+                       rng.below(COLS + 6) - 3 - spawn.center.j, rng.below(4));
+    if (board.check(block) != ref_check(board.bitmap, block)) {
+      FAIL("check: " << describe(posn(block.translation.i, block.translation.j,
+                                      block.rotation))
+           << " is " << board.check(block) << ", reference "
+           << ref_check(board.bitmap, block));
+    }
+  }
+  return "";
+}
+
+// `spawn` is a copy, since do_commands moves the board's block.
+string check_moves(Board& board, Block spawn) {
+  vector<Cells> expected;
+  ref_landings(board.bitmap, spawn, expected);
+  board.generate_moves();
+
+  vector<Cells> landings;
+  float best = 1e30f;
+  FeatureCache cache;
+  board.cache_features(cache);
+  for (size_t k = 0; k < board.placements.size(); k++) {
+    const posn& pos = board.placements[k];
+    Block block = spawn;
+    block.set_position(pos);
+    if (!ref_check(board.bitmap, block)) {
+      FAIL("generate_moves: placement " << describe(pos) << " is not valid");
+    }
+    Cells landing = ref_landing(board.bitmap, block);
+    landings.push_back(landing);
+
+    Bitmap bitmap;
+    memcpy(bitmap, board.bitmap, sizeof(Bitmap));
+    int rows_cleared = ref_place(bitmap, landing);
+    float score = ref_score(bitmap, board.heuristic_params);
+    best = min(best, score);
+
+    Board* placed = board.place(pos);
+    string diff = compare_bitmaps(placed->bitmap, bitmap);
+    if (!diff.empty()) FAIL("place(pos): " << describe(pos) << ": " << diff);
+    if (placed->rows_cleared != rows_cleared) {
+      FAIL("place(pos): " << describe(pos) << " cleared " << placed->rows_cleared
+           << " rows, reference " << rows_cleared);
+    }
+    delete placed;
+
+    float fast = board.score_placement(cache, pos);
+    if (fast != score) {
+      FAIL("score_placement: " << describe(pos) << " scored " << fast
+           << ", reference " << score);
+    }
+
+    // The commands must be legal moves all the way and end above the same
+    // landing, and do_commands must drop the block there.
+    vector<string> commands = board.commands_for(pos);
+    block = spawn;
+    for (size_t m = 0; m < commands.size(); m++) {
+      block.do_command(commands[m]);
+      if (!ref_check(board.bitmap, block)) {
+        FAIL("commands_for: " << describe(pos) << ": [" << join_commands(commands)
+             << "] makes an invalid move");
+      }
+    }
+    if (ref_landing(board.bitmap, block) != landing) {
+      FAIL("commands_for: " << describe(pos) << ": [" << join_commands(commands)
+           << "] lands at " << describe(ref_landing(board.bitmap, block)));
+    }
+    placed = board.do_commands(commands);
+    board.block->reset_position();
+    diff = compare_bitmaps(placed->bitmap, bitmap);
+    if (!diff.empty()) FAIL("place: " << describe(pos) << ": " << diff);
+    delete placed;
+  }
+
+  // generate_moves merges rotations that cover the same squares about the
+  // same center only, so a piece whose turned copy matches it after a shift
+  // (a domino turned twice) can reach one landing from two placements. The
+  // landings are compared as sets.
+  vector<Cells> sorted = landings;
+  sort(sorted.begin(), sorted.end());
+  for (size_t k = 0; k < expected.size(); k++) {
+    if (!binary_search(sorted.begin(), sorted.end(), expected[k])) {
+      FAIL("generate_moves: no placement lands at " << describe(expected[k]));
+    }
+  }
+  for (size_t k = 0; k < sorted.size(); k++) {
+    if (!binary_search(expected.begin(), expected.end(), sorted[k])) {
+      FAIL("generate_moves: the reference cannot land at " << describe(sorted[k]));
+    }
+  }
+
+  board.choose_move(0);
+  if (board.min_score != best) {
+    FAIL("choose_move: best score " << board.min_score << ", reference " << best);
+  }
+  return "";
+}
+
+// Runs every check on `c`, returning the first failure or "" if it passes.
+// `placements` counts the placements checked.
+string run_case(const Case& c, long long* placements) {
+  Block* block = new Block(c.center, &c.offsets[0], c.offsets.size());
+  vector<Block*> preview(PREVIEW_SIZE, block);
+  Board board(c.bitmap, block, preview);
+  memcpy(board.heuristic_params, c.params, sizeof(c.params));
+  Rng rng(c.probe_seed);
+
+  string failure = check_features(board, board.bitmap);
+  if (failure.empty()) failure = check_remove_rows(c, rng);
+  if (failure.empty()) failure = check_check(board, *block, rng);
+  // A piece that does not fit at its spawn position ends the game.
+  if (failure.empty() && ref_check(board.bitmap, *block)) {
+    failure = check_moves(board, *block);
+    *placements += board.placements.size();
+  }
+  delete block;
+  return failure;
+}
+
+string check_name(const string& failure) {
+  return failure.substr(0, failure.find(':'));
+}
+
+// Greedily simplifies `c` while the same check keeps failing: first the
+// weights, then the piece one square at a time, then the board one cell at a
+// time, until nothing more can go.
+string shrink(Case& c, string failure) {
+  string name = check_name(failure);
+  long long ignored = 0;
+  bool progress = true;
+  while (progress) {
+    progress = false;
+
+    if (memcmp(c.params, default_heuristic_params, sizeof(c.params))) {
+      Case smaller = c;
+      memcpy(smaller.params, default_heuristic_params, sizeof(smaller.params));
+      string result = run_case(smaller, &ignored);
+      if (!result.empty() && check_name(result) == name) {
+        c = smaller;
+        failure = result;
+        progress = true;
+      }
+    }
+
+    // The first offset is the piece's center square.
+    for (int k = c.offsets.size() - 1; k > 0; k--) {
+      Case smaller = c;
+      smaller.offsets.erase(smaller.offsets.begin() + k);
+      string result = run_case(smaller, &ignored);
+      if (!result.empty() && check_name(result) == name) {
+        c = smaller;
+        failure = result;
+        progress = true;
+      }
+    }
+
+    for (int i = 0; i < ROWS; i++) {
+      for (int j = 0; j < COLS; j++) {
+        if (!c.bitmap[i][j]) continue;
+        c.bitmap[i][j] = 0;
+        string result = run_case(c, &ignored);
+        if (!result.empty() && check_name(result) == name) {
+          failure = result;
+          progress = true;
+        } else {
+          c.bitmap[i][j] = 1;
+        }
+      }
+    }
+  }
+  return failure;
+}
+
+void print_case(const Case& c) {
+  Block block(c.center, &c.offsets[0], c.offsets.size());
+  Cells cells = ref_cells(block);
+  for (int i = 0; i < ROWS; i++) {
+    string row;
+    for (int j = 0; j < COLS; j++) {
+      bool piece = binary_search(cells.begin(), cells.end(), make_pair(i, j));
+      row += piece ? (c.bitmap[i][j] ? '*' : 'o') : (c.bitmap[i][j] ? 'X' : '.');
+    }
+    printf("  %s\n", row.c_str());
+  }
+  printf("weights:");
+  for (int k = 0; k < NUM_FEATURES; k++) {
+    printf(" %g", c.params[k]);
+  }
+  printf("\n");
+
+  Case copy = c;
+  vector<Block*> preview(PREVIEW_SIZE, &block);
+  Board board(copy.bitmap, &block, preview);
+  ostringstream state;
+  write_state(state, board);
+  printf("state: %s\n", state.str().c_str());
+}
+
+int main(int argc, char** argv) {
+  int cases = 2000;
+  unsigned long long seed = 1;
+  int min_size = 1;
+  int max_size = 8;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(argv[i - 1], "--cases")) {
+      cases = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--seed")) {
+      seed = strtoull(value, NULL, 10);
+    } else if (!strcmp(argv[i - 1], "--min-size")) {
+      min_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--max-size")) {
+      max_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--threads")) {
+      omp_set_num_threads(atoi(value));
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (min_size < 1 || max_size > 10 || min_size > max_size) {
+    cerr << "piece sizes must satisfy 1 <= A <= B <= 10" << endl;
+    return 1;
+  }
+
+  double start = omp_get_wtime();
+  vector<string> failures(cases);
+  long long placements = 0;
+  #pragma omp parallel for schedule(dynamic, 1) reduction(+:placements)
+  for (int i = 0; i < cases; i++) {
+    failures[i] = run_case(make_case(seed + i, min_size, max_size), &placements);
+  }
+  double elapsed = omp_get_wtime() - start;
+
+  int failed = 0, first = -1;
+  for (int i = 0; i < cases; i++) {
+    if (failures[i].empty()) continue;
+    if (first < 0) first = i;
+    failed++;
+  }
+  printf("%d cases, %lld placements: %d failed, %.2fs\n", cases, placements,
+         failed, elapsed);
+  if (first < 0) return 0;
+
+  Case c = make_case(seed + first, min_size, max_size);
+  printf("seed %llu: %s\n", seed + first, failures[first].c_str());
+  string failure = shrink(c, failures[first]);
+  printf("shrunk to: %s\n", failure.c_str());
+  print_case(c);
+  return 1;
+}
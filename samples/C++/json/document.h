@@ -0,0 +1,201 @@
+/******************************************************************************
+
+Copyright (c) 2009-2010, Terry Caton
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the projecct nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+******************************************************************************/
+
+#pragma once
+
+#include "elements.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+
+The Document classes are a read-only, allocation-light alternative to the
+UnknownElement tree. Reader::Read(Document&, ...) parses straight from a
+character buffer into a Document: every Value, array and member table is
+carved out of the document's Arena, and strings without escape sequences
+point directly into the document's copy of the source text. The whole tree
+is released in one step when the document is cleared or destroyed.
+
+Use the UnknownElement classes when the tree needs to be modified or
+written back out; use a Document when a large document is read once.
+
+*/
+
+namespace json
+{
+
+/////////////////////////////////////////////////////////////////////////
+// Arena - bump allocator. Memory is handed out from large blocks and is
+//  only ever released all at once, by Clear() or the destructor. Clear()
+//  keeps the first block around so a reused arena stops allocating once it
+//  has grown to fit the largest document it has seen.
+
+class Arena
+{
+public:
+   Arena(size_t nBlockSize = 16 * 1024);
+   ~Arena();
+
+   void* Allocate(size_t nBytes);
+   void Clear();
+
+   size_t BytesUsed() const;
+
+private:
+   Arena(const Arena&);
+   Arena& operator = (const Arena&);
+
+   struct Block
+   {
+      Block* pNext;
+      size_t nSize;
+      size_t nUsed;
+   };
+
+   Block* NewBlock(size_t nMinSize);
+
+   Block* m_pHead;
+   size_t m_nBlockSize;
+   size_t m_nBytesUsed;
+};
+
+
+/////////////////////////////////////////////////////////////////////////
+// Value - arena-owned, read-only counterpart of UnknownElement. A Value is
+//  16 bytes: a type tag, a length (string characters, array elements or
+//  object members) and a payload. Accessors throw json::Exception on a
+//  type mismatch, just like UnknownElement's const casts.
+
+class Value
+{
+public:
+   enum Type
+   {
+      NULL_VALUE,
+      BOOLEAN_VALUE,
+      NUMBER_VALUE,
+      STRING_VALUE,
+      ARRAY_VALUE,
+      OBJECT_VALUE,
+   };
+
+   struct Member;
+
+   Value();
+
+   Type GetType() const;
+
+   double AsNumber() const;
+   bool AsBoolean() const;
+   std::string AsString() const;
+
+   // string contents, not null-terminated
+   const char* StringData() const;
+   size_t StringLength() const;
+
+   // number of array elements or object members
+   size_t Size() const;
+
+   // array access. throws if we aren't an array or index is out of bounds
+   const Value& operator[] (size_t index) const;
+
+   // object access. throws if we aren't an object or the member is missing
+   const Value& operator[] (const std::string& key) const;
+   const Value& operator[] (const char* key) const;
+
+   // returns 0 if we aren't an object or the member is missing
+   const Value* Find(const char* key, size_t nKeyLength) const;
+
+   const Member& MemberAt(size_t index) const;
+
+private:
+   friend class Reader;
+
+   void Require(Type nType) const;
+
+   unsigned int m_nType;
+   unsigned int m_nSize;
+   union
+   {
+      double m_dNumber;
+      bool m_bBoolean;
+      const char* m_pString;
+      const Value* m_pElements;
+      const Member* m_pMembers;
+   };
+};
+
+
+struct Value::Member
+{
+   const char* pName;
+   size_t nNameLength;
+   Value value;
+};
+
+
+/////////////////////////////////////////////////////////////////////////
+// Document - owns the arena, the source text and the root Value. Reading
+//  into a document that already holds a tree discards the old tree first;
+//  the scratch stacks used while parsing are kept for the next read.
+
+class Document
+{
+public:
+   Document();
+
+   const Value& Root() const;
+
+   const Value& operator[] (const std::string& key) const;
+   const Value& operator[] (size_t index) const;
+
+   void Clear();
+
+   size_t BytesUsed() const;
+
+private:
+   Document(const Document&);
+   Document& operator = (const Document&);
+
+   friend class Reader;
+
+   Arena m_Arena;
+   std::string m_sSource;
+   Value m_Root;
+
+   std::vector<Value> m_ElementStack;
+   std::vector<Value::Member> m_MemberStack;
+};
+
+
+} // End namespace
+
+
+#include "document.inl"
@@ -0,0 +1,207 @@
+/******************************************************************************
+
+Copyright (c) 2009-2010, Terry Caton
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the projecct nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON
+ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+******************************************************************************/
+
+#include <cstdlib>
+#include <cstring>
+
+namespace json
+{
+
+
+////////////////
+// Arena members
+
+inline Arena::Arena(size_t nBlockSize) :
+   m_pHead(0),
+   m_nBlockSize(nBlockSize),
+   m_nBytesUsed(0)
+{}
+
+inline Arena::~Arena()
+{
+   while (m_pHead)
+   {
+      Block* pNext = m_pHead->pNext;
+      std::free(m_pHead);
+      m_pHead = pNext;
+   }
+}
+
+inline Arena::Block* Arena::NewBlock(size_t nMinSize)
+{
+   size_t nSize = (nMinSize > m_nBlockSize ? nMinSize : m_nBlockSize);
+   Block* pBlock = static_cast<Block*>(std::malloc(sizeof(Block) + nSize));
+   if (pBlock == 0)
+      throw Exception("Arena out of memory");
+   pBlock->pNext = m_pHead;
+   pBlock->nSize = nSize;
+   pBlock->nUsed = 0;
+   m_pHead = pBlock;
+   return pBlock;
+}
+
+inline void* Arena::Allocate(size_t nBytes)
+{
+   // everything we hand out is 8-byte aligned, which covers double & pointers
+   nBytes = (nBytes + 7) & ~size_t(7);
+
+   Block* pBlock = m_pHead;
+   if (pBlock == 0 || pBlock->nSize - pBlock->nUsed < nBytes)
+   {
+      // grow geometrically so big documents need only a handful of blocks
+      if (m_pHead)
+         m_nBlockSize *= 2;
+      pBlock = NewBlock(nBytes);
+   }
+
+   void* p = reinterpret_cast<char*>(pBlock + 1) + pBlock->nUsed;
+   pBlock->nUsed += nBytes;
+   m_nBytesUsed += nBytes;
+   return p;
+}
+
+inline void Arena::Clear()
+{
+   if (m_pHead == 0)
+      return;
+
+   // keep only the newest (and largest) block
+   Block* pBlock = m_pHead->pNext;
+   while (pBlock)
+   {
+      Block* pNext = pBlock->pNext;
+      std::free(pBlock);
+      pBlock = pNext;
+   }
+   m_pHead->pNext = 0;
+   m_pHead->nUsed = 0;
+   m_nBytesUsed = 0;
+}
+
+inline size_t Arena::BytesUsed() const { return m_nBytesUsed; }
+
+
+////////////////
+// Value members
+
+inline Value::Value() :
+   m_nType(NULL_VALUE),
+   m_nSize(0),
+   m_pString(0)
+{}
+
+inline Value::Type Value::GetType() const { return static_cast<Type>(m_nType); }
+
+inline void Value::Require(Type nType) const
+{
+   if (m_nType != static_cast<unsigned int>(nType))
+      throw Exception("Bad cast");
+}
+
+inline double Value::AsNumber() const           { Require(NUMBER_VALUE); return m_dNumber; }
+inline bool Value::AsBoolean() const            { Require(BOOLEAN_VALUE); return m_bBoolean; }
+inline std::string Value::AsString() const      { Require(STRING_VALUE); return std::string(m_pString, m_nSize); }
+inline const char* Value::StringData() const    { Require(STRING_VALUE); return m_pString; }
+inline size_t Value::StringLength() const       { Require(STRING_VALUE); return m_nSize; }
+
+inline size_t Value::Size() const
+{
+   if (m_nType != ARRAY_VALUE && m_nType != OBJECT_VALUE)
+      throw Exception("Bad cast");
+   return m_nSize;
+}
+
+inline const Value& Value::operator[] (size_t index) const
+{
+   Require(ARRAY_VALUE);
+   if (index >= m_nSize)
+      throw Exception("Array out of bounds");
+   return m_pElements[index];
+}
+
+inline const Value* Value::Find(const char* key, size_t nKeyLength) const
+{
+   if (m_nType != OBJECT_VALUE)
+      return 0;
+   for (unsigned int i = 0; i < m_nSize; ++i)
+   {
+      const Member& member = m_pMembers[i];
+      if (member.nNameLength == nKeyLength &&
+          std::memcmp(member.pName, key, nKeyLength) == 0)
+         return &member.value;
+   }
+   return 0;
+}
+
+inline const Value& Value::operator[] (const char* key) const
+{
+   Require(OBJECT_VALUE);
+   const Value* pValue = Find(key, std::strlen(key));
+   if (pValue == 0)
+      throw Exception(std::string("Object member not found: ") + key);
+   return *pValue;
+}
+
+inline const Value& Value::operator[] (const std::string& key) const
+{
+   return (*this)[key.c_str()];
+}
+
+inline const Value::Member& Value::MemberAt(size_t index) const
+{
+   Require(OBJECT_VALUE);
+   if (index >= m_nSize)
+      throw Exception("Object member out of bounds");
+   return m_pMembers[index];
+}
+
+
+///////////////////
+// Document members
+
+inline Document::Document() {}
+
+inline const Value& Document::Root() const { return m_Root; }
+
+inline const Value& Document::operator[] (const std::string& key) const   { return m_Root[key]; }
+inline const Value& Document::operator[] (size_t index) const             { return m_Root[index]; }
+
+inline void Document::Clear()
+{
+   m_Root = Value();
+   m_Arena.Clear();
+   m_sSource.clear();
+   m_ElementStack.clear();
+   m_MemberStack.clear();
+}
+
+inline size_t Document::BytesUsed() const { return m_Arena.BytesUsed(); }
+
+
+} // End namespace
@@ -32,6 +32,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #pragma once
 
 #include "elements.h"
+#include "document.h"
+#include "visitor.h"
 #include <iostream>
 #include <vector>
 
@@ -89,6 +91,19 @@ public:
    // ...otherwise, if you don't know, call this & visit it
    static void Read(UnknownElement& elementRoot, std::istream& istr);
 
+   // arena mode: parses straight from the character buffer into a Document, with
+   //  no token sequence and no UnknownElement tree. see document.h
+   static void Read(Document& document, std::istream& istr);
+   static void Read(Document& document, const std::string& sSource);
+   static void Read(Document& document, const char* pSource, size_t nLength);
+
+   // streaming mode: reports every value to the visitor as soon as it is scanned,
+   //  without building a token sequence or a tree, so memory use is bounded by
+   //  nesting depth & the longest string rather than document size. reads
+   //  top-level values until the end of the stream. duplicate object members are
+   //  not detected in this mode
+   static void Stream(StreamVisitor& visitor, std::istream& istr);
+
 private:
    struct Token
    {
@@ -116,6 +131,7 @@ private:
 
    class InputStream;
    class TokenStream;
+   class BufferParser;
    typedef std::vector<Token> Tokens;
 
    template <typename ElementTypeT>   
@@ -124,6 +140,9 @@ private:
    // scanning istream into token sequence
    void Scan(Tokens& tokens, InputStream& inputStream);
 
+   void Stream_i(StreamVisitor& visitor, InputStream& inputStream);
+   char PeekExpected(InputStream& inputStream);
+
    void EatWhiteSpace(InputStream& inputStream);
    std::string MatchString(InputStream& inputStream);
    std::string MatchNumber(InputStream& inputStream);
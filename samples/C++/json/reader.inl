@@ -28,6 +28,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 ******************************************************************************/
 
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <set>
 #include <sstream>
 
@@ -146,6 +149,338 @@ inline bool Reader::TokenStream::EOS() const {
    return m_itCurrent == m_Tokens.end(); 
 }
 
+
+///////////////////////
+// Reader::BufferParser
+
+// single-pass recursive descent parser behind the arena-mode Read(Document&, ...)
+//  overloads. values are built on the document's scratch stacks and copied into
+//  the arena in one contiguous block once each array or object is closed.
+class Reader::BufferParser
+{
+public:
+   BufferParser(Document& document) :
+      m_Document(document),
+      m_pBegin(document.m_sSource.data()),
+      m_pCur(m_pBegin),
+      m_pEnd(m_pBegin + document.m_sSource.size()) {}
+
+   void ParseDocument(Value& root);
+
+private:
+   void ParseValue(Value& value);
+   void ParseArray(Value& value);
+   void ParseObject(Value& value);
+   void ParseString(const char*& pString, size_t& nLength);
+   void ParseNumber(Value& value);
+   void MatchLiteral(const char* sExpected, size_t nLength);
+
+   void EatWhiteSpace() {
+      while (m_pCur != m_pEnd && ::isspace(static_cast<unsigned char>(*m_pCur)))
+         ++m_pCur;
+   }
+
+   char Peek() {
+      if (m_pCur == m_pEnd)
+         Fail("Unexpected end of document");
+      return *m_pCur;
+   }
+
+   void Expect(char c) {
+      if (Peek() != c)
+         Fail(std::string("Expected string: ") + c);
+      ++m_pCur;
+   }
+
+   Location GetLocation() const;
+   void Fail(const std::string& sMessage) const;
+
+   Document& m_Document;
+   const char* m_pBegin;
+   const char* m_pCur;
+   const char* m_pEnd;
+};
+
+
+inline Reader::Location Reader::BufferParser::GetLocation() const
+{
+   // only needed when reporting errors, so work it out the slow way
+   Location location;
+   for (const char* p = m_pBegin; p != m_pCur; ++p)
+   {
+      ++location.m_nDocOffset;
+      if (*p == '\n') {
+         ++location.m_nLine;
+         location.m_nLineOffset = 0;
+      }
+      else {
+         ++location.m_nLineOffset;
+      }
+   }
+   return location;
+}
+
+inline void Reader::BufferParser::Fail(const std::string& sMessage) const
+{
+   throw ScanException(sMessage, GetLocation());
+}
+
+inline void Reader::BufferParser::ParseDocument(Value& root)
+{
+   EatWhiteSpace();
+   ParseValue(root);
+   EatWhiteSpace();
+   if (m_pCur != m_pEnd)
+      Fail(std::string("Expected End of document; found ") + *m_pCur);
+}
+
+inline void Reader::BufferParser::ParseValue(Value& value)
+{
+   switch (Peek())
+   {
+      case '{':
+         ParseObject(value);
+         break;
+
+      case '[':
+         ParseArray(value);
+         break;
+
+      case '"':
+         value.m_nType = Value::STRING_VALUE;
+         {
+            size_t nLength;
+            ParseString(value.m_pString, nLength);
+            value.m_nSize = static_cast<unsigned int>(nLength);
+         }
+         break;
+
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+         ParseNumber(value);
+         break;
+
+      case 't':
+         MatchLiteral("true", 4);
+         value.m_nType = Value::BOOLEAN_VALUE;
+         value.m_bBoolean = true;
+         break;
+
+      case 'f':
+         MatchLiteral("false", 5);
+         value.m_nType = Value::BOOLEAN_VALUE;
+         value.m_bBoolean = false;
+         break;
+
+      case 'n':
+         MatchLiteral("null", 4);
+         value.m_nType = Value::NULL_VALUE;
+         break;
+
+      default:
+         Fail(std::string("Unexpected character in stream: ") + *m_pCur);
+   }
+}
+
+inline void Reader::BufferParser::ParseArray(Value& value)
+{
+   Expect('[');
+   EatWhiteSpace();
+
+   std::vector<Value>& stack = m_Document.m_ElementStack;
+   size_t nBase = stack.size();
+
+   if (Peek() != ']')
+   {
+      while (true)
+      {
+         // parse into a local; the stack may reallocate during nested parsing
+         Value element;
+         EatWhiteSpace();
+         ParseValue(element);
+         stack.push_back(element);
+
+         EatWhiteSpace();
+         if (Peek() != ',')
+            break;
+         ++m_pCur;
+      }
+   }
+   Expect(']');
+
+   size_t nCount = stack.size() - nBase;
+   Value* pElements = 0;
+   if (nCount)
+   {
+      pElements = static_cast<Value*>(m_Document.m_Arena.Allocate(nCount * sizeof(Value)));
+      std::memcpy(pElements, &stack[nBase], nCount * sizeof(Value));
+   }
+   stack.resize(nBase);
+
+   value.m_nType = Value::ARRAY_VALUE;
+   value.m_nSize = static_cast<unsigned int>(nCount);
+   value.m_pElements = pElements;
+}
+
+inline void Reader::BufferParser::ParseObject(Value& value)
+{
+   Expect('{');
+   EatWhiteSpace();
+
+   std::vector<Value::Member>& stack = m_Document.m_MemberStack;
+   size_t nBase = stack.size();
+
+   if (Peek() != '}')
+   {
+      while (true)
+      {
+         Value::Member member;
+
+         // first the member name...
+         EatWhiteSpace();
+         if (Peek() != '"')
+            Fail("Expected string: \"");
+         ParseString(member.pName, member.nNameLength);
+
+         // ...then the key/value separator...
+         EatWhiteSpace();
+         Expect(':');
+
+         // ...then the value itself (can be anything).
+         EatWhiteSpace();
+         ParseValue(member.value);
+
+         for (size_t i = nBase; i < stack.size(); ++i)
+         {
+            if (stack[i].nNameLength == member.nNameLength &&
+                std::memcmp(stack[i].pName, member.pName, member.nNameLength) == 0)
+               Fail("Duplicate object member token: " + std::string(member.pName, member.nNameLength));
+         }
+         stack.push_back(member);
+
+         EatWhiteSpace();
+         if (Peek() != ',')
+            break;
+         ++m_pCur;
+      }
+   }
+   Expect('}');
+
+   size_t nCount = stack.size() - nBase;
+   Value::Member* pMembers = 0;
+   if (nCount)
+   {
+      pMembers = static_cast<Value::Member*>(m_Document.m_Arena.Allocate(nCount * sizeof(Value::Member)));
+      std::memcpy(pMembers, &stack[nBase], nCount * sizeof(Value::Member));
+   }
+   stack.resize(nBase);
+
+   value.m_nType = Value::OBJECT_VALUE;
+   value.m_nSize = static_cast<unsigned int>(nCount);
+   value.m_pMembers = pMembers;
+}
+
+inline void Reader::BufferParser::ParseString(const char*& pString, size_t& nLength)
+{
+   Expect('"');
+
+   // common case: no escapes, so the value can point straight into the source
+   const char* pStart = m_pCur;
+   while (m_pCur != m_pEnd && *m_pCur != '"' && *m_pCur != '\\')
+      ++m_pCur;
+   if (Peek() == '"')
+   {
+      pString = pStart;
+      nLength = m_pCur - pStart;
+      ++m_pCur;
+      return;
+   }
+
+   // escapes only ever shrink the string, so its source length bounds it.
+   //  find the closing quote first so only that much comes out of the arena
+   const char* pClose = m_pCur;
+   while (pClose != m_pEnd && *pClose != '"')
+      pClose += (*pClose == '\\' && pClose + 1 != m_pEnd) ? 2 : 1;
+   char* pOut = static_cast<char*>(m_Document.m_Arena.Allocate(pClose - pStart));
+   size_t nOut = m_pCur - pStart;
+   std::memcpy(pOut, pStart, nOut);
+
+   while (Peek() != '"')
+   {
+      char c = *m_pCur++;
+      if (c == '\\')
+      {
+         c = Peek();
+         ++m_pCur;
+         switch (c) {
+            case '/':      pOut[nOut++] = '/';     break;
+            case '"':      pOut[nOut++] = '"';     break;
+            case '\\':     pOut[nOut++] = '\\';    break;
+            case 'b':      pOut[nOut++] = '\b';    break;
+            case 'f':      pOut[nOut++] = '\f';    break;
+            case 'n':      pOut[nOut++] = '\n';    break;
+            case 'r':      pOut[nOut++] = '\r';    break;
+            case 't':      pOut[nOut++] = '\t';    break;
+            default: {
+               std::string sMessage = std::string("Unrecognized escape sequence found in string: \\") + c;
+               Fail(sMessage);
+            }
+         }
+      }
+      else {
+         pOut[nOut++] = c;
+      }
+   }
+   ++m_pCur;
+
+   pString = pOut;
+   nLength = nOut;
+}
+
+inline void Reader::BufferParser::ParseNumber(Value& value)
+{
+   // same character set as Reader::MatchNumber
+   const char* pStart = m_pCur;
+   while (m_pCur != m_pEnd &&
+          ((*m_pCur >= '0' && *m_pCur <= '9') ||
+           *m_pCur == '.' || *m_pCur == 'e' || *m_pCur == 'E' ||
+           *m_pCur == '-' || *m_pCur == '+'))
+      ++m_pCur;
+
+   // copy out so strtod can't run past the token
+   char sNumber[64];
+   size_t nLength = m_pCur - pStart;
+   if (nLength >= sizeof(sNumber))
+      Fail("NUMBER token too long: " + std::string(pStart, nLength));
+   std::memcpy(sNumber, pStart, nLength);
+   sNumber[nLength] = '\0';
+
+   char* pNumberEnd;
+   double dValue = std::strtod(sNumber, &pNumberEnd);
+   if (pNumberEnd != sNumber + nLength)
+      Fail(std::string("Unexpected character in NUMBER token: ") + *pNumberEnd);
+
+   value.m_nType = Value::NUMBER_VALUE;
+   value.m_dNumber = dValue;
+}
+
+inline void Reader::BufferParser::MatchLiteral(const char* sExpected, size_t nLength)
+{
+   if (static_cast<size_t>(m_pEnd - m_pCur) < nLength ||
+       std::memcmp(m_pCur, sExpected, nLength) != 0)
+      Fail(std::string("Expected string: ") + sExpected);
+   m_pCur += nLength;
+}
+
 ///////////////////
 // Reader (finally)
 
@@ -159,6 +494,169 @@ inline void Reader::Read(Null& null, std::istream& istr)                    { Re
 inline void Reader::Read(UnknownElement& unknown, std::istream& istr)       { Read_i(unknown, istr); }
 
 
+inline void Reader::Read(Document& document, std::istream& istr)
+{
+   std::string sSource((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+   Read(document, sSource);
+}
+
+inline void Reader::Read(Document& document, const std::string& sSource)
+{
+   Read(document, sSource.data(), sSource.size());
+}
+
+inline void Reader::Read(Document& document, const char* pSource, size_t nLength)
+{
+   document.Clear();
+
+   // string values point into this copy, so it lives as long as the tree does
+   document.m_sSource.assign(pSource, nLength);
+
+   BufferParser parser(document);
+   Value root;
+   parser.ParseDocument(root);
+   document.m_Root = root;
+}
+
+
+inline void Reader::Stream(StreamVisitor& visitor, std::istream& istr)
+{
+   Reader reader;
+   InputStream inputStream(istr);
+
+   while (reader.EatWhiteSpace(inputStream),  // ignore any leading white space...
+          inputStream.EOS() == false)         // ...before checking for EOS
+   {
+      reader.Stream_i(visitor, inputStream);
+      visitor.EndDocument();
+   }
+}
+
+
+inline char Reader::PeekExpected(InputStream& inputStream)
+{
+   EatWhiteSpace(inputStream);
+   if (inputStream.EOS())
+      throw ScanException("Unexpected end of stream", inputStream.GetLocation());
+   return inputStream.Peek();
+}
+
+
+inline void Reader::Stream_i(StreamVisitor& visitor, InputStream& inputStream)
+{
+   Location locBegin = inputStream.GetLocation();
+   char sChar = PeekExpected(inputStream);
+   switch (sChar)
+   {
+      case '{':
+      {
+         MatchExpectedString(inputStream, "{");
+         visitor.BeginObject();
+         if (PeekExpected(inputStream) != '}')
+         {
+            while (true)
+            {
+               if (PeekExpected(inputStream) != '"')
+                  throw ScanException("Expected string: \"", inputStream.GetLocation());
+               std::string sName = MatchString(inputStream);
+
+               PeekExpected(inputStream);
+               MatchExpectedString(inputStream, ":");
+
+               visitor.Member(sName);
+               Stream_i(visitor, inputStream);
+
+               if (PeekExpected(inputStream) != ',')
+                  break;
+               MatchExpectedString(inputStream, ",");
+            }
+         }
+         MatchExpectedString(inputStream, "}");
+         visitor.EndObject();
+         break;
+      }
+
+      case '[':
+      {
+         MatchExpectedString(inputStream, "[");
+         visitor.BeginArray();
+         if (PeekExpected(inputStream) != ']')
+         {
+            while (true)
+            {
+               Stream_i(visitor, inputStream);
+
+               if (PeekExpected(inputStream) != ',')
+                  break;
+               MatchExpectedString(inputStream, ",");
+            }
+         }
+         MatchExpectedString(inputStream, "]");
+         visitor.EndArray();
+         break;
+      }
+
+      case '"':
+      {
+         String string = MatchString(inputStream);
+         visitor.Visit(string);
+         break;
+      }
+
+      case '-':
+      case '0':
+      case '1':
+      case '2':
+      case '3':
+      case '4':
+      case '5':
+      case '6':
+      case '7':
+      case '8':
+      case '9':
+      {
+         std::string sValue = MatchNumber(inputStream);
+
+         // did we consume all characters in the token?
+         char* pEnd;
+         double dValue = std::strtod(sValue.c_str(), &pEnd);
+         if (pEnd != sValue.c_str() + sValue.size())
+         {
+            std::string sMessage = std::string("Unexpected character in NUMBER token: ") + *pEnd;
+            throw ParseException(sMessage, locBegin, inputStream.GetLocation());
+         }
+
+         Number number = dValue;
+         visitor.Visit(number);
+         break;
+      }
+
+      case 't':
+      case 'f':
+      {
+         Boolean boolean = (sChar == 't');
+         MatchExpectedString(inputStream, sChar == 't' ? "true" : "false");
+         visitor.Visit(boolean);
+         break;
+      }
+
+      case 'n':
+      {
+         Null null;
+         MatchExpectedString(inputStream, "null");
+         visitor.Visit(null);
+         break;
+      }
+
+      default:
+      {
+         std::string sErrorMessage = std::string("Unexpected character in stream: ") + sChar;
+         throw ScanException(sErrorMessage, inputStream.GetLocation());
+      }
+   }
+}
+
+
 template <typename ElementTypeT>   
 void Reader::Read_i(ElementTypeT& element, std::istream& istr)
 {
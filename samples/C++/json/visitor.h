@@ -62,4 +62,54 @@ public:
 };
 
 
+/////////////////////////////////////////////////////////////////////////
+// StreamVisitor - event-driven counterpart of Visitor, used by
+//  Reader::Stream. Scalars are still delivered through the Visit()
+//  overloads (the element is a temporary, valid only during the call);
+//  arrays & objects are reported as begin/end events instead, with
+//  Member() announcing the name of each object member before its value.
+// Visit(Array&) and Visit(Object&) replay an in-memory tree as the same
+//  event sequence, so a StreamVisitor can equally be driven by
+//  UnknownElement::Accept.
+
+class StreamVisitor : public Visitor
+{
+public:
+   virtual void BeginArray() = 0;
+   virtual void EndArray() = 0;
+   virtual void BeginObject() = 0;
+   virtual void Member(const std::string& name) = 0;
+   virtual void EndObject() = 0;
+
+   // called after each top-level value. a stream may hold many of them
+   //  (one per line, for instance)
+   virtual void EndDocument() {}
+
+   virtual void Visit(Array& array);
+   virtual void Visit(Object& object);
+
+   using Visitor::Visit;
+};
+
+
+inline void StreamVisitor::Visit(Array& array)
+{
+   BeginArray();
+   for (Array::iterator it = array.Begin(); it != array.End(); ++it)
+      it->Accept(*this);
+   EndArray();
+}
+
+inline void StreamVisitor::Visit(Object& object)
+{
+   BeginObject();
+   for (Object::iterator it = object.Begin(); it != object.End(); ++it)
+   {
+      Member(it->name);
+      it->element.Accept(*this);
+   }
+   EndObject();
+}
+
+
 } // End namespace
@@ -0,0 +1,123 @@
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "json/reader.h"
+
+using namespace json;
+using namespace std;
+
+// Checks for the json library's Document and streaming readers. Run with
+// `make test`; prints each failure and exits 1 if there are any.
+
+int failures = 0;
+
+#define EXPECT(condition)                                           \
+  if (!(condition)) {                                               \
+    printf("%s:%d: expected %s\n", __FILE__, __LINE__, #condition); \
+    failures++;                                                     \
+  }
+
+// A string with escapes is decoded into the arena. Each one must take about
+// its own length from it, not the rest of the document.
+void test_escaped_strings() {
+  const int count = 2000;
+  ostringstream source;
+  source << "[";
+  for (int k = 0; k < count; k++) {
+    source << (k ? ", " : "") << "\"line " << k << "\\nwith a \\\"quote\\\" and some padding\"";
+  }
+  source << "]";
+  string text = source.str();
+
+  Document document;
+  Reader::Read(document, text);
+  EXPECT(document.Root().Size() == count);
+  EXPECT(document[0].AsString() == "line 0\nwith a \"quote\" and some padding");
+  EXPECT(document[count - 1].AsString() ==
+         "line 1999\nwith a \"quote\" and some padding");
+  // The values and the decoded strings, which are no longer than their
+  // source, fit in a small multiple of the source.
+  EXPECT(document.BytesUsed() < 2 * text.size() + count * sizeof(Value));
+}
+
+// Escapes right before the closing quote and at the end of a document.
+void test_escape_edges() {
+  Document document;
+  Reader::Read(document, string("[\"\\\\\", \"a\\\"\", \"\\t\"]"));
+  EXPECT(document[0].AsString() == "\\");
+  EXPECT(document[1].AsString() == "a\"");
+  EXPECT(document[2].AsString() == "\t");
+
+  bool threw = false;
+  try {
+    Reader::Read(document, string("[\"abc\\"));
+  } catch (Exception&) {
+    threw = true;
+  }
+  EXPECT(threw);
+}
+
+// Writes down every event it sees, one per line.
+class RecordingVisitor : public StreamVisitor {
+ public:
+  ostringstream events;
+  int documents;
+
+  RecordingVisitor() : documents(0) {}
+
+  void BeginArray() { events << "[\n"; }
+  void EndArray() { events << "]\n"; }
+  void BeginObject() { events << "{\n"; }
+  void Member(const string& name) { events << "member " << name << "\n"; }
+  void EndObject() { events << "}\n"; }
+  void EndDocument() { documents++; }
+
+  void Visit(Number& number) { events << "number " << number.Value() << "\n"; }
+  void Visit(String& string) { events << "string " << string.Value() << "\n"; }
+  void Visit(Boolean& boolean) { events << "boolean " << boolean.Value() << "\n"; }
+  void Visit(Null&) { events << "null\n"; }
+
+  using StreamVisitor::Visit;
+};
+
+// Reader::Stream must report the same events as reading each document into
+// an UnknownElement and replaying it, without building the tree.
+void test_stream_matches_dom() {
+  vector<string> documents;
+  documents.push_back("{\"state\": {\"bitmap\": [[0, 1], [1, 0]], \"block\": "
+                      "{\"center\": {\"i\": 1, \"j\": -5}, \"offsets\": []}}, "
+                      "\"seconds\": 12.5}");
+  documents.push_back("[true, false, null, \"a\\\"b\\n\", -1.5e3, {}, [[]]]");
+  documents.push_back("\"just a string\"");
+
+  string text;
+  RecordingVisitor expected;
+  for (size_t k = 0; k < documents.size(); k++) {
+    text += documents[k] + "\n";
+    UnknownElement element;
+    istringstream in(documents[k]);
+    Reader::Read(element, in);
+    element.Accept(expected);
+  }
+
+  RecordingVisitor streamed;
+  istringstream in(text);
+  Reader::Stream(streamed, in);
+  EXPECT(streamed.events.str() == expected.events.str());
+  EXPECT(streamed.documents == (int)documents.size());
+  EXPECT(streamed.events.str().find("member seconds\nnumber 12.5\n") != string::npos);
+}
+
+int main() {
+  test_escaped_strings();
+  test_escape_edges();
+  test_stream_matches_dom();
+  if (failures) {
+    printf("%d failed\n", failures);
+    return 1;
+  }
+  printf("all passed\n");
+  return 0;
+}
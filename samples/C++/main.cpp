@@ -0,0 +1,117 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "batch.h"
+#include "dropblox_ai.h"
+#include "telemetry.h"
+#include "time_budget.h"
+
+using namespace json;
+using namespace std;
+
+int test () 
+{Bitmap bitmap = {
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 9},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8},
+            {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8},
+            {1, 1, 0, 4, 0, 2, 2, 0, 0, 0, 0, 9},
+            {0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 8},
+     };
+     cout << Board::count_holes (bitmap) << endl;
+     cout << Board::altitude (bitmap) << endl;
+     cout << Board::full_cells (bitmap) << endl;
+     cout << Board::higher_slope (bitmap) << endl;
+     cout << Board::roughness (bitmap) << endl;
+     cout << Board::full_cells_weighted (bitmap) << endl;
+     cout << Board::countComponents (bitmap) << endl;
+
+     return 0;
+}
+
+int main(int argc, char** argv) {
+     // test ();
+     // return 0;
+
+  if (argc > 1 && !strcmp(argv[1], "--batch")) {
+    return run_batch(argc, argv);
+  }
+
+  double start = omp_get_wtime();
+  TELEMETRY(if (argc > 2) telemetry.seconds_left = atof(argv[2]));
+
+  // Parse the given game state. The whole document lives in one arena, so
+  // this is a handful of allocations rather than one per JSON value.
+  Document state;
+  Reader::Read(state, argv[1], strlen(argv[1]));
+  TELEMETRY(telemetry.parse = omp_get_wtime() - start);
+
+  // Construct a board from the parsed state.
+  Board board(state.Root());
+
+  // An optional third argument overrides the heuristic weights, either with a
+  // weight file (as written by ./tune) or a list like "20,1,2,5,5,0,10".
+  if (argc > 3 && !load_heuristic_params(argv[3], board.heuristic_params)) {
+    cerr << "bad weights: " << argv[3] << endl;
+    return 1;
+  }
+
+  // The second argument is the time left in the competition, which client.py
+  // always passes, so real games search against the clock. Without it the
+  // search goes to the fixed SEARCH_DEPTH.
+  int depth = SEARCH_DEPTH;
+  if (argc > 2) {
+    double deadline = turn_deadline(board, atof(argv[2]), start);
+    depth = board.search(MAX_SEARCH_DEPTH, deadline);
+  } else {
+    board.search(SEARCH_DEPTH);
+  }
+  TELEMETRY(telemetry.depth = depth);
+
+  TELEMETRY(double output_start = omp_get_wtime());
+  board.print_moves(board.best);
+  TELEMETRY(cout.flush());
+  TELEMETRY(telemetry.output = omp_get_wtime() - output_start);
+  TELEMETRY(telemetry.total = omp_get_wtime() - start);
+  TELEMETRY(telemetry.emit(stderr));
+
+  // // Make some moves!
+  // vector<string> moves;
+  // while (board.check(*board.block)) {
+  //   board.block->left();
+  //   moves.push_back("left");
+  // }
+  // // Ignore the last move, because it moved the block into invalid
+  // // position. Make all the rest.
+  // for (int i = 0; i < moves.size() - 1; i++) {
+  //   cout << moves[i] << endl;
+  // }
+}
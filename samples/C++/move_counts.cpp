@@ -0,0 +1,91 @@
+#include "move_counts.h"
+
+MoveCounts::MoveCounts()
+    : boards(0), dead(0), positions(0), placements(0), mismatches(0), hash(0) {}
+
+void MoveCounts::add(const MoveCounts& other) {
+  boards += other.boards;
+  dead += other.dead;
+  positions += other.positions;
+  placements += other.placements;
+  mismatches += other.mismatches;
+  hash += other.hash;
+}
+
+// splitmix64's finalizer, so that summing board hashes mixes well.
+static unsigned long long mix(unsigned long long x) {
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+// FNV-1a over the filled cells and the block's shape, combined with the hash
+// of its reachable positions.
+static unsigned long long board_hash(const Board& board,
+                                     unsigned long long positions_hash) {
+  unsigned long long h = 1469598103934665603ULL;
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      h = (h ^ (unsigned)board.bitmap[i][j]) * 1099511628211ULL;
+    }
+  }
+  h = (h ^ (unsigned)board.block->shape->id) * 1099511628211ULL;
+  return mix(h ^ positions_hash);
+}
+
+static bool same_placements(const vector<posn>& a, const vector<posn>& b) {
+  if (a.size() != b.size()) return false;
+  for (int k = 0; k < a.size(); k++) {
+    if (a[k].tx != b[k].tx || a[k].ty != b[k].ty || a[k].rot != b[k].rot) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void count_board(Board& board, int ply, int plies, bool verify,
+                        MoveCounts* counts) {
+  MoveCounts& out = counts[ply];
+  out.boards++;
+  if (!board.check(*board.block)) {
+    out.dead++;
+    return;
+  }
+
+  unsigned long long positions_hash;
+  int positions = board.count_positions(false, &positions_hash, NULL);
+  board.generate_moves();
+  out.positions += positions;
+  out.placements += board.placements.size();
+  out.hash += board_hash(board, positions_hash);
+
+  if (verify) {
+    unsigned long long searched_hash;
+    vector<posn> searched;
+    int searched_positions = board.count_positions(true, &searched_hash, &searched);
+    if (searched_positions != positions || searched_hash != positions_hash ||
+        !same_placements(searched, board.placements)) {
+      out.mismatches++;
+    }
+  }
+
+  if (ply + 1 == plies) return;
+  // Each child generates its own moves, so the list stays put.
+  for (int k = 0; k < board.placements.size(); k++) {
+    Board* child = board.place(board.placements[k]);
+    count_board(*child, ply + 1, plies, verify, counts);
+    delete child;
+  }
+}
+
+void count_moves(const vector<Board*>& roots, int plies, bool verify,
+                 vector<vector<MoveCounts> >& counts) {
+  int n = roots.size();
+  counts.assign(n, vector<MoveCounts>(plies));
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int b = 0; b < n; b++) {
+    int limit = min(plies, 1 + (int)roots[b]->preview.size());
+    count_board(*roots[b], 0, limit, verify, &counts[b][0]);
+  }
+}
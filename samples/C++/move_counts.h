@@ -0,0 +1,44 @@
+#pragma once
+
+#include "dropblox_ai.h"
+
+#include <vector>
+
+using namespace std;
+
+// Perft-style counts of the move generator's output, for checking it against
+// the path search and timing it. A root board is searched ply by ply like
+// choose_move does without pruning: ply 1 is the root with its current
+// block, and ply p + 1 every board one of ply p's placements leads to, with
+// the next block of the preview. A root with n preview blocks can be counted
+// to at most n + 1 plies.
+
+struct MoveCounts {
+  // Boards at this ply, and those among them whose block does not fit at its
+  // spawn position (the game would be over; they have no moves).
+  long long boards;
+  long long dead;
+  // Positions reachable from spawn and placements, summed over the boards.
+  // The placements at ply p are the boards at ply p + 1.
+  long long positions;
+  long long placements;
+  // With verification, the boards on which generate_moves and the path
+  // search disagree about the positions or the placements.
+  long long mismatches;
+  // A hash of the boards and their reachable positions. It does not depend
+  // on the order the boards were visited in, so it is the same however the
+  // work is split up, and adding the hashes of two sets of boards gives the
+  // hash of both.
+  unsigned long long hash;
+
+  MoveCounts();
+  void add(const MoveCounts& other);
+};
+
+// Counts `plies` plies from each root across all cores, into counts[b][p - 1]
+// for root b and ply p. Roots with too short a preview stop early and leave
+// their later plies zero. With `verify`, every board's positions and
+// placements are also found by the path search behind commands_for and
+// compared. The roots' placement lists are used as scratch.
+void count_moves(const vector<Board*>& roots, int plies, bool verify,
+                 vector<vector<MoveCounts> >& counts);
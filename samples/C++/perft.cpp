@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "corpus.h"
+#include "fixtures.h"
+#include "move_counts.h"
+
+using namespace std;
+
+// Counts what the move generator produces, perft style (see move_counts.h),
+// and how fast. Usage:
+//
+//   ./perft [--corpus FILE] [--plies N] [--threads T] [--verify] [--repeat R]
+//
+// The roots are the bench fixtures with each tetromino as the current block,
+// or with --corpus the states of a corpus (see corpus.h). Each root gets one
+// line per ply with its counts and hash, and the totals follow with the rate
+// at which positions and placements were generated. --verify checks every
+// board against the path search and makes the exit status 1 on a mismatch;
+// it is part of the timed work. --repeat counts R times and reports the
+// fastest. The counts and hashes do not depend on --threads.
+
+void usage(const char* name) {
+  cerr << "usage: " << name << " [--corpus FILE] [--plies N] [--threads T]"
+       << " [--verify] [--repeat R]" << endl;
+  exit(1);
+}
+
+void print_counts(const char* root, int ply, const MoveCounts& counts) {
+  printf("%-12s ply %d: %10lld boards %12lld positions %12lld placements"
+         " %8lld dead  %016llx\n", root, ply, counts.boards, counts.positions,
+         counts.placements, counts.dead, counts.hash);
+}
+
+int main(int argc, char** argv) {
+  const char* corpus_path = NULL;
+  int plies = 2;
+  bool verify = false;
+  int repeat = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--verify")) {
+      verify = true;
+      continue;
+    }
+    if (i + 1 >= argc) usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(argv[i - 1], "--corpus")) {
+      corpus_path = value;
+    } else if (!strcmp(argv[i - 1], "--plies")) {
+      plies = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--threads")) {
+      omp_set_num_threads(atoi(value));
+    } else if (!strcmp(argv[i - 1], "--repeat")) {
+      repeat = max(1, atoi(value));
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (plies < 1 || plies > PREVIEW_SIZE + 1) {
+    cerr << "--plies must be between 1 and " << PREVIEW_SIZE + 1 << endl;
+    return 1;
+  }
+
+  vector<Board*> roots;
+  vector<string> names;
+  if (corpus_path) {
+    ifstream in(corpus_path);
+    if (!in) {
+      cerr << "cannot open " << corpus_path << endl;
+      return 1;
+    }
+    CorpusReader reader(in);
+    try {
+      while (reader.next()) {
+        roots.push_back(new Board(reader.state()));
+        names.push_back("line " + to_string(reader.line_number()));
+      }
+    } catch (json::Exception& e) {
+      cerr << corpus_path << ":" << reader.line_number() << ": " << e.what()
+           << endl;
+      return 1;
+    }
+    if (roots.empty()) {
+      cerr << corpus_path << ": no records" << endl;
+      return 1;
+    }
+  } else {
+    for (int i = 0; i < num_fixtures; i++) {
+      for (int shape = 0; shape < NUM_SHAPES; shape++) {
+        roots.push_back(make_board(fixtures[i], shape));
+        names.push_back(string(fixtures[i].name) + "/" + shape_names[shape]);
+      }
+    }
+  }
+
+  vector<vector<MoveCounts> > counts;
+  double best = 0;
+  for (int pass = 0; pass < repeat; pass++) {
+    double start = omp_get_wtime();
+    count_moves(roots, plies, verify, counts);
+    double elapsed = omp_get_wtime() - start;
+    if (pass == 0 || elapsed < best) best = elapsed;
+  }
+
+  vector<MoveCounts> totals(plies);
+  for (size_t b = 0; b < roots.size(); b++) {
+    for (int p = 0; p < plies; p++) {
+      print_counts(names[b].c_str(), p + 1, counts[b][p]);
+      totals[p].add(counts[b][p]);
+    }
+  }
+  MoveCounts all;
+  for (int p = 0; p < plies; p++) {
+    print_counts("total", p + 1, totals[p]);
+    all.add(totals[p]);
+  }
+
+  printf("%d roots, %d plies%s: %.3fs, %.0f positions/s, %.0f placements/s\n",
+         (int)roots.size(), plies, verify ? ", verified" : "", best,
+         all.positions / best, all.placements / best);
+  if (verify) {
+    printf("%lld of %lld boards mismatched\n", all.mismatches, all.boards);
+  }
+
+  for (size_t b = 0; b < roots.size(); b++) {
+    delete roots[b]->block;
+    for (size_t i = 0; i < roots[b]->preview.size(); i++) {
+      delete roots[b]->preview[i];
+    }
+    delete roots[b];
+  }
+  return all.mismatches ? 1 : 0;
+}
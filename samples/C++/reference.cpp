@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cstring>
+#include <queue>
+#include <set>
+
+#include "reference.h"
+
+Cells ref_cells(const Block& block) {
+  Cells cells;
+  for (int i = 0; i < block.size; i++) {
+    int row = block.center.i + block.translation.i;
+    int col = block.center.j + block.translation.j;
+    if (block.rotation % 2) {
+      row += (2 - block.rotation)*block.offsets[i].j;
+      col += -(2 - block.rotation)*block.offsets[i].i;
+    } else {
+      row += (1 - block.rotation)*block.offsets[i].i;
+      col += (1 - block.rotation)*block.offsets[i].j;
+    }
+    cells.push_back(make_pair(row, col));
+  }
+  sort(cells.begin(), cells.end());
+  return cells;
+}
+
+bool ref_check(const Bitmap& bitmap, const Block& block) {
+  Cells cells = ref_cells(block);
+  for (int k = 0; k < cells.size(); k++) {
+    int i = cells[k].first, j = cells[k].second;
+    if (i < 0 || i >= ROWS || j < 0 || j >= COLS || bitmap[i][j]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Cells ref_landing(const Bitmap& bitmap, const Block& block) {
+  Block moved = block;
+  while (ref_check(bitmap, moved)) {
+    moved.down();
+  }
+  moved.up();
+  return ref_cells(moved);
+}
+
+int ref_remove_rows(Bitmap& bitmap, int first, int last, vector<int>* cleared) {
+  int rows_removed = 0;
+  for (int i = ROWS - 1; i >= 0; i--) {
+    bool full = (i >= first && i <= last);
+    for (int j = 0; full && j < COLS; j++) {
+      if (!bitmap[i][j]) full = false;
+    }
+    if (full) {
+      rows_removed++;
+      if (cleared) cleared->insert(cleared->begin(), i);
+    } else if (rows_removed) {
+      for (int j = 0; j < COLS; j++) {
+        bitmap[i + rows_removed][j] = bitmap[i][j];
+      }
+    }
+  }
+  for (int i = 0; i < rows_removed; i++) {
+    for (int j = 0; j < COLS; j++) {
+      bitmap[i][j] = 0;
+    }
+  }
+  return rows_removed;
+}
+
+int ref_place(Bitmap& bitmap, const Cells& cells) {
+  for (int k = 0; k < cells.size(); k++) {
+    bitmap[cells[k].first][cells[k].second] = 1;
+  }
+  return ref_remove_rows(bitmap, 0, ROWS - 1, NULL);
+}
+
+void ref_landings(const Bitmap& bitmap, const Block& block, vector<Cells>& landings) {
+  set<Cells> found;
+  set<vector<int> > visited;
+  queue<Block> pending;
+  pending.push(block);
+  visited.insert({block.translation.i, block.translation.j, block.rotation});
+
+  while (!pending.empty()) {
+    Block at = pending.front();
+    pending.pop();
+    found.insert(ref_landing(bitmap, at));
+    for (int m = 0; m < 5; m++) {
+      Block next = at;
+      if (m == 0) next.rotate();
+      if (m == 1) next.right();
+      if (m == 2) next.left();
+      if (m == 3) next.down();
+      if (m == 4) next.up();
+      if (ref_check(bitmap, next) &&
+          visited.insert({next.translation.i, next.translation.j, next.rotation}).second) {
+        pending.push(next);
+      }
+    }
+  }
+  landings.assign(found.begin(), found.end());
+}
+
+//-------------------------------------------
+// The heuristics, as the engine first had them.
+//-------------------------------------------
+
+static int count_holes(const Bitmap& newState) {
+  // A cell is a hole if it is empty but somewhere above it, there is
+  // block or part of a block.
+  int hole_count = 0;
+  for (int col = 0; col < COLS; col++) {
+    bool has_ceiling = false;
+    for (int row = 0; row < ROWS; row++) {
+      if (newState[row][col] == 0 && has_ceiling) {
+        hole_count++;
+      }
+      if (newState[row][col] != 0) {
+        has_ceiling = true;
+      }
+    }
+  }
+  return hole_count;
+}
+
+static int altitude(const Bitmap& newState) {
+  int res = 0;
+  for (int i = ROWS - 1; i >= 0; i--) {
+    bool success = false;
+    for (int j = 0; j < COLS; j++) {
+      if (newState[i][j]) {
+        success = true;
+        break;
+      }
+    }
+    if (!success) break;
+    res++;
+  }
+  return res;
+}
+
+static int full_cells(const Bitmap& newState) {
+  int count = 0;
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      if (newState[i][j] != 0) count++;
+    }
+  }
+  return count;
+}
+
+// How far the column next to the top of column `col` (at `row`) drops below
+// it, if nothing in that column is above `row`; 0 otherwise.
+static int side_drop(const Bitmap& newState, int row, int col) {
+  if (col < 0 || col >= COLS) return 0;
+  for (int i = row - 1; i >= 0; i--) {
+    if (newState[i][col] != 0) return 0;
+  }
+  int height = 0;
+  for (int i = row; i < ROWS && newState[i][col] == 0; i++) {
+    height++;
+  }
+  return height;
+}
+
+// Sums and takes the largest of the drops on either side of each column's
+// top, as roughness and higher_slope do.
+static void slopes(const Bitmap& newState, int* sum, int* largest) {
+  *sum = *largest = 0;
+  for (int col = 0; col < COLS; col++) {
+    for (int row = 0; row < ROWS; row++) {
+      if (newState[row][col] != 0) {
+        int left = side_drop(newState, row, col - 1);
+        int right = side_drop(newState, row, col + 1);
+        *sum += left + right;
+        *largest = max(*largest, max(left, right));
+        break;
+      }
+    }
+  }
+}
+
+static int full_cells_weighted(const Bitmap& newState) {
+  int count = 0;
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      if (newState[i][j] != 0) count += ROWS - i;
+    }
+  }
+  return count;
+}
+
+// Connected regions of same-colored cells, filled or empty.
+static int count_components(const Bitmap& newState) {
+  int di[] = {-1, 0, 0, 1};
+  int dj[] = {0, 1, -1, 0};
+  vector<vector<bool> > visited(ROWS, vector<bool>(COLS, false));
+  int res = 0;
+  for (int i = 0; i < ROWS; i++) {
+    for (int j = 0; j < COLS; j++) {
+      if (visited[i][j]) continue;
+      res++;
+      vector<pair<int, int> > stack(1, make_pair(i, j));
+      visited[i][j] = true;
+      while (!stack.empty()) {
+        pair<int, int> at = stack.back();
+        stack.pop_back();
+        for (int d = 0; d < 4; d++) {
+          int x = at.first + di[d], y = at.second + dj[d];
+          if (x < 0 || x >= ROWS || y < 0 || y >= COLS || visited[x][y]) continue;
+          if (!newState[x][y] != !newState[i][j]) continue;
+          visited[x][y] = true;
+          stack.push_back(make_pair(x, y));
+        }
+      }
+    }
+  }
+  return res;
+}
+
+void ref_features(const Bitmap& bitmap, int* out) {
+  out[0] = count_holes(bitmap);
+  out[1] = altitude(bitmap);
+  out[2] = full_cells(bitmap);
+  slopes(bitmap, &out[4], &out[3]);
+  out[5] = full_cells_weighted(bitmap);
+  out[6] = count_components(bitmap);
+}
+
+float ref_score(const Bitmap& bitmap, const float* params) {
+  int values[NUM_FEATURES];
+  ref_features(bitmap, values);
+  float score = 0.0;
+  for (int k = 0; k < NUM_FEATURES; k++) {
+    if (params[k]) score += params[k]*values[k];
+  }
+  return score;
+}
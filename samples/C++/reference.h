@@ -0,0 +1,46 @@
+#pragma once
+
+#include "dropblox_ai.h"
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// A reference model of the game rules and the heuristics, written the way the
+// engine originally did them: cell by cell on the bitmap, with a block's
+// squares worked out from its raw offsets on every call and moves found by a
+// breadth-first search over Block positions. It is slow and shares no code
+// with the engine's masks, shapes or move generator, so ./fuzz can hold the
+// engine's fast paths to it.
+
+// A block's squares as (row, column) pairs, sorted. Blocks are compared by
+// the squares they cover, not by how they got there.
+typedef vector<pair<int, int> > Cells;
+
+// The squares `block` covers at its current position.
+Cells ref_cells(const Block& block);
+
+// Board::check: every square in bounds and on an empty cell.
+bool ref_check(const Bitmap& bitmap, const Block& block);
+
+// Where `block` comes to rest dropped from its current position, which must
+// be valid.
+Cells ref_landing(const Bitmap& bitmap, const Block& block);
+
+// Board::remove_rows for the full rows from `first` through `last`. The rows
+// removed, by index before the removal and in increasing order, go to
+// `cleared` if it is not NULL.
+int ref_remove_rows(Bitmap& bitmap, int first, int last, vector<int>* cleared);
+
+// Fills `cells` into `bitmap` and removes the full rows; returns how many.
+int ref_place(Bitmap& bitmap, const Cells& cells);
+
+// Every landing the block can reach from its current position by the moves
+// dropblox_ai sends, one per distinct set of squares, sorted.
+void ref_landings(const Bitmap& bitmap, const Block& block, vector<Cells>& landings);
+
+// The heuristics, in heuristic_params order (see NUM_FEATURES), and get_score
+// summed the same way.
+void ref_features(const Bitmap& bitmap, int* out);
+float ref_score(const Bitmap& bitmap, const float* params);
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "corpus.h"
+#include "time_budget.h"
+
+using namespace std;
+
+// Replays a corpus of captured turns (see corpus.h) through the same pipeline
+// dropblox_ai runs on a real turn, and reports the distribution of per-turn
+// latency. Usage:
+//
+//   ./replay CORPUS [--depth D] [--clock] [--baseline FILE]
+//                   [--write-baseline FILE] [--repeat N] [--weights W]
+//
+// Every turn is searched to a fixed depth, D or SEARCH_DEPTH, so runs are
+// repeatable. With --clock, turns whose record has "seconds" are instead
+// searched the way dropblox_ai searches a turn given that much time left:
+// deepening until the turn's share of it is used up (see time_budget.h).
+// The moves then depend on how fast the machine is.
+//
+// With --baseline, every turn whose chosen commands differ from the baseline
+// is listed and the exit status is 1. --write-baseline saves the commands
+// chosen on this run. --repeat runs the whole corpus N times and keeps the
+// fastest time of each turn, to take noise out of the percentiles. --weights
+// plays with other heuristic weights (a weight file or a list, see
+// load_heuristic_params).
+
+void usage(const char* name) {
+  cerr << "usage: " << name << " CORPUS [--depth D] [--clock] [--baseline FILE]"
+       << " [--write-baseline FILE] [--repeat N] [--weights W]" << endl;
+  exit(1);
+}
+
+// One turn, timed the way dropblox_ai spends it: parse the state, search,
+// and produce the command list. A non-negative `seconds` is the time left in
+// the competition, and the search runs against the clock as with
+// dropblox_ai's second argument.
+double run_turn(const Value& state, int depth, double seconds,
+                const float* params, string& chosen) {
+  double start = omp_get_wtime();
+  Board board(state);
+  memcpy(board.heuristic_params, params, sizeof(board.heuristic_params));
+  if (seconds >= 0) {
+    board.search(MAX_SEARCH_DEPTH, turn_deadline(board, seconds, start));
+  } else {
+    board.search(depth);
+  }
+  chosen = join_commands(board.best);
+  double elapsed = omp_get_wtime() - start;
+
+  delete board.block;
+  for (int i = 0; i < board.preview.size(); i++) {
+    delete board.preview[i];
+  }
+  return elapsed;
+}
+
+double percentile(const vector<double>& sorted, double p) {
+  int index = (int)(p * (sorted.size() - 1) + 0.5);
+  return sorted[index];
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) usage(argv[0]);
+  const char* corpus_path = argv[1];
+  const char* baseline_path = NULL;
+  const char* write_path = NULL;
+  int depth = SEARCH_DEPTH;
+  int repeat = 1;
+  bool clock = false;
+  float params[NUM_FEATURES];
+  memcpy(params, default_heuristic_params, sizeof(params));
+
+  for (int i = 2; i < argc; i++) {
+    if (!strcmp(argv[i], "--clock")) {
+      clock = true;
+      continue;
+    }
+    if (i + 1 >= argc) usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(argv[i - 1], "--depth")) {
+      depth = atoi(value);
+      if (depth < 0 || depth > MAX_SEARCH_DEPTH) {
+        cerr << "--depth must be between 0 and " << MAX_SEARCH_DEPTH << endl;
+        return 1;
+      }
+    } else if (!strcmp(argv[i - 1], "--baseline")) {
+      baseline_path = value;
+    } else if (!strcmp(argv[i - 1], "--write-baseline")) {
+      write_path = value;
+    } else if (!strcmp(argv[i - 1], "--repeat")) {
+      repeat = max(1, atoi(value));
+    } else if (!strcmp(argv[i - 1], "--weights")) {
+      if (!load_heuristic_params(value, params)) {
+        cerr << "bad weights: " << value << endl;
+        return 1;
+      }
+    } else {
+      usage(argv[0]);
+    }
+  }
+
+  vector<string> baseline;
+  if (baseline_path) {
+    ifstream in(baseline_path);
+    if (!in) {
+      cerr << "cannot open " << baseline_path << endl;
+      return 1;
+    }
+    read_baseline(in, baseline);
+  }
+
+  vector<double> latencies;
+  vector<string> chosen;
+  vector<int> lines;
+  for (int pass = 0; pass < repeat; pass++) {
+    ifstream in(corpus_path);
+    if (!in) {
+      cerr << "cannot open " << corpus_path << endl;
+      return 1;
+    }
+    CorpusReader reader(in);
+    int turn = 0;
+    try {
+      while (reader.next()) {
+        string commands;
+        double seconds = clock ? reader.seconds() : -1;
+        double elapsed = run_turn(reader.state(), depth, seconds, params, commands);
+        if (pass == 0) {
+          latencies.push_back(elapsed);
+          chosen.push_back(commands);
+          lines.push_back(reader.line_number());
+        } else {
+          latencies[turn] = min(latencies[turn], elapsed);
+        }
+        turn++;
+      }
+    } catch (json::Exception& e) {
+      cerr << corpus_path << ":" << reader.line_number() << ": " << e.what()
+           << endl;
+      return 1;
+    }
+  }
+
+  if (latencies.empty()) {
+    cerr << corpus_path << ": no records" << endl;
+    return 1;
+  }
+
+  int changed = 0;
+  if (baseline_path) {
+    if (baseline.size() != chosen.size()) {
+      printf("baseline has %d turns, corpus has %d\n",
+             (int)baseline.size(), (int)chosen.size());
+    }
+    for (int i = 0; i < chosen.size() && i < baseline.size(); i++) {
+      if (chosen[i] != baseline[i]) {
+        printf("turn %d (line %d) changed: [%s] -> [%s]\n", i, lines[i],
+               baseline[i].c_str(), chosen[i].c_str());
+        changed++;
+      }
+    }
+  }
+
+  if (write_path) {
+    ofstream out(write_path);
+    for (int i = 0; i < chosen.size(); i++) {
+      out << chosen[i] << "\n";
+    }
+  }
+
+  vector<double> sorted = latencies;
+  sort(sorted.begin(), sorted.end());
+  double total = 0;
+  int slowest = 0;
+  for (int i = 0; i < latencies.size(); i++) {
+    total += latencies[i];
+    if (latencies[i] > latencies[slowest]) slowest = i;
+  }
+  if (clock) {
+    printf("%d turns on the recorded clock", (int)latencies.size());
+  } else {
+    printf("%d turns at depth %d", (int)latencies.size(), depth);
+  }
+  printf(": mean %.3fms, p50 %.3fms, p99 %.3fms, max %.3fms (turn %d, line %d)\n",
+         total / latencies.size() * 1e3,
+         percentile(sorted, 0.5) * 1e3, percentile(sorted, 0.99) * 1e3,
+         sorted.back() * 1e3, slowest, lines[slowest]);
+  if (baseline_path) {
+    printf("%d of %d turns changed against %s\n", changed,
+           (int)chosen.size(), baseline_path);
+  }
+  return (changed || (baseline_path && baseline.size() != chosen.size())) ? 1 : 0;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+// Lookup tables indexed by a row's occupancy mask, where bit j is set if
+// column j is filled. A board `Cols` wide has 2^Cols possible rows, so for
+// narrow boards (the standard 12 columns has 4096) the per-row terms of the
+// heuristics are computed once, at compile time, and evaluation does a table
+// load per row instead of branching per cell. See BoardMasks for how they
+// are used.
+
+// Widest board that gets tables; wider ones compute the same terms with bit
+// tricks.
+#define ROW_TABLE_MAX_COLS 12
+
+template <int Cols>
+struct RowTables {
+  // Number of filled cells.
+  unsigned char cells[1 << Cols];
+  // Number of places where neighbouring cells differ (one filled, one empty).
+  unsigned char transitions[1 << Cols];
+  // Bit j is set if a maximal run of same-coloured cells starts at column j.
+  // Its popcount is the number of runs, transitions + 1.
+  unsigned short run_starts[1 << Cols];
+};
+
+template <int Cols>
+constexpr RowTables<Cols> make_row_tables() {
+  static_assert(Cols <= ROW_TABLE_MAX_COLS, "row tables are for narrow boards");
+  RowTables<Cols> tables = {};
+  for (int m = 0; m < (1 << Cols); m++) {
+    int cells = 0, transitions = 0, starts = 1;
+    for (int j = 0; j < Cols; j++) {
+      cells += (m >> j) & 1;
+      if (j > 0 && ((m >> j) & 1) != ((m >> (j - 1)) & 1)) {
+        transitions++;
+        starts |= 1 << j;
+      }
+    }
+    tables.cells[m] = cells;
+    tables.transitions[m] = transitions;
+    tables.run_starts[m] = starts;
+  }
+  return tables;
+}
+
+template <int Cols>
+constexpr RowTables<Cols> row_tables = make_row_tables<Cols>();
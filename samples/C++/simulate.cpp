@@ -0,0 +1,106 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "simulator.h"
+
+using namespace std;
+
+// Plays seeded games locally with the in-process AI and prints one line per
+// game followed by a summary. Usage:
+//
+//   ./simulate [--games N] [--seed S] [--depth D] [--max-pieces P]
+//              [--min-size A] [--max-size B] [--threads T] [--record FILE]
+//              [--weights W]
+//
+// Game i uses seed S + i, so any single game can be replayed with --games 1.
+// --record writes every turn of every game to FILE as a corpus (see corpus.h).
+// --weights plays with other heuristic weights (a weight file or a list, see
+// load_heuristic_params).
+
+void usage(const char* name) {
+  cerr << "usage: " << name << " [--games N] [--seed S] [--depth D]"
+       << " [--max-pieces P] [--min-size A] [--max-size B] [--threads T]"
+       << " [--record FILE] [--weights W]" << endl;
+  exit(1);
+}
+
+int main(int argc, char** argv) {
+  SimConfig config;
+  int games = 16;
+  unsigned long long seed = 1;
+  const char* record_path = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(argv[i - 1], "--games")) {
+      games = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--seed")) {
+      seed = strtoull(value, NULL, 10);
+    } else if (!strcmp(argv[i - 1], "--depth")) {
+      config.depth = atoi(value);
+      if (config.depth < 0 || config.depth > MAX_SEARCH_DEPTH) {
+        cerr << "--depth must be between 0 and " << MAX_SEARCH_DEPTH << endl;
+        return 1;
+      }
+    } else if (!strcmp(argv[i - 1], "--max-pieces")) {
+      config.max_pieces = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--min-size")) {
+      config.min_piece_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--max-size")) {
+      config.max_piece_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--threads")) {
+      omp_set_num_threads(atoi(value));
+    } else if (!strcmp(argv[i - 1], "--record")) {
+      record_path = value;
+      config.record = true;
+    } else if (!strcmp(argv[i - 1], "--weights")) {
+      if (!load_heuristic_params(value, config.params)) {
+        cerr << "bad weights: " << value << endl;
+        return 1;
+      }
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (games <= 0 || config.min_piece_size < 1 || config.max_piece_size > 10 ||
+      config.min_piece_size > config.max_piece_size) {
+    usage(argv[0]);
+  }
+
+  vector<unsigned long long> seeds;
+  for (int i = 0; i < games; i++) {
+    seeds.push_back(seed + i);
+  }
+
+  Simulator simulator(config);
+  vector<GameResult> results;
+  double start = omp_get_wtime();
+  simulator.play_many(seeds, results);
+  double elapsed = omp_get_wtime() - start;
+
+  if (record_path) {
+    ofstream record(record_path);
+    for (int i = 0; i < results.size(); i++) {
+      record << results[i].record;
+    }
+  }
+
+  long long total_score = 0;
+  long long total_pieces = 0;
+  for (int i = 0; i < results.size(); i++) {
+    const GameResult& r = results[i];
+    printf("seed %llu: score %d, pieces %d, rows %d, %s, %.3fs\n",
+           r.seed, r.score, r.pieces, r.rows_cleared,
+           r.topped_out ? "topped out" : "cut off", r.seconds);
+    total_score += r.score;
+    total_pieces += r.pieces;
+  }
+  printf("%d games in %.2fs (%.1f games/min, %.0f pieces/s), mean score %.2f\n",
+         games, elapsed, games * 60.0 / elapsed, total_pieces / elapsed,
+         (double)total_score / games);
+  return 0;
+}
@@ -0,0 +1,156 @@
+#include <set>
+#include <sstream>
+#include <utility>
+
+#include "corpus.h"
+#include "simulator.h"
+
+//--------------------------------
+// Rng implementation starts here!
+//--------------------------------
+
+Rng::Rng(unsigned long long seed) {
+  state = seed;
+}
+
+unsigned long long Rng::next() {
+  unsigned long long z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+int Rng::below(int n) {
+  return (int)(next() % (unsigned long long)n);
+}
+
+//-------------------------------------------
+// PieceGenerator implementation starts here!
+//-------------------------------------------
+
+PieceGenerator::PieceGenerator(unsigned long long seed, int min_size, int max_size)
+    : rng(seed), min_size(min_size), max_size(max_size) {
+}
+
+Block* PieceGenerator::next() {
+  int size = min_size + rng.below(max_size - min_size + 1);
+
+  // Grow the piece from its center by repeatedly attaching a square to a
+  // random side of a random existing square.
+  int di[] = {-1, 0, 0, 1};
+  int dj[] = {0, 1, -1, 0};
+  vector<pair<int, int> > cells;
+  set<pair<int, int> > taken;
+  cells.push_back(make_pair(0, 0));
+  taken.insert(make_pair(0, 0));
+  while ((int)cells.size() < size) {
+    pair<int, int> from = cells[rng.below(cells.size())];
+    int dir = rng.below(4);
+    pair<int, int> cell = make_pair(from.first + di[dir], from.second + dj[dir]);
+    if (taken.insert(cell).second) {
+      cells.push_back(cell);
+    }
+  }
+
+  Point offsets[10];
+  int top = 0;
+  for (int k = 0; k < size; k++) {
+    offsets[k].i = cells[k].first;
+    offsets[k].j = cells[k].second;
+    top = min(top, offsets[k].i);
+  }
+
+  // Spawn with the topmost square on row 0, roughly centered.
+  Point center;
+  center.i = -top;
+  center.j = COLS / 2 - 1;
+  return new Block(center, offsets, size);
+}
+
+//--------------------------------------
+// Simulator implementation starts here!
+//--------------------------------------
+
+SimConfig::SimConfig() {
+  depth = SEARCH_DEPTH;
+  max_pieces = 500;
+  min_piece_size = 4;
+  max_piece_size = 4;
+  record = false;
+  memcpy(params, default_heuristic_params, sizeof(params));
+}
+
+Simulator::Simulator(const SimConfig& config) : config(config) {
+}
+
+int Simulator::points(int rows) {
+  return (1 << rows) - 1;
+}
+
+GameResult Simulator::play(unsigned long long seed) const {
+  GameResult result;
+  result.seed = seed;
+  result.score = 0;
+  result.pieces = 0;
+  result.rows_cleared = 0;
+  result.topped_out = false;
+  double start = omp_get_wtime();
+
+  PieceGenerator generator(seed, config.min_piece_size, config.max_piece_size);
+
+  Bitmap empty;
+  memset(empty, 0, sizeof(empty));
+  vector<Block*> preview;
+  for (int i = 0; i < PREVIEW_SIZE; i++) {
+    preview.push_back(generator.next());
+  }
+  Board* board = new Board(empty, generator.next(), preview);
+  memcpy(board->heuristic_params, config.params, sizeof(config.params));
+  ostringstream record;
+
+  while (config.max_pieces == 0 || result.pieces < config.max_pieces) {
+    if (!board->check(*board->block)) {
+      result.topped_out = true;
+      break;
+    }
+
+    if (config.record) {
+      write_record(record, *board, -1);
+    }
+    board->search(config.depth);
+
+    Block* placed = board->block;
+    Board* next = board->do_commands(board->best);
+    int cleared = next->rows_cleared;
+
+    result.pieces += 1;
+    result.rows_cleared += cleared;
+    result.score += points(cleared);
+
+    // The new board shares the remaining preview blocks; only the block we
+    // just dropped is no longer referenced by anyone.
+    next->preview.push_back(generator.next());
+    delete placed;
+    delete board;
+    board = next;
+  }
+
+  delete board->block;
+  for (int i = 0; i < board->preview.size(); i++) {
+    delete board->preview[i];
+  }
+  delete board;
+
+  result.seconds = omp_get_wtime() - start;
+  result.record = record.str();
+  return result;
+}
+
+void Simulator::play_many(const vector<unsigned long long>& seeds,
+                          vector<GameResult>& results) const {
+  results.resize(seeds.size());
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < (int)seeds.size(); i++) {
+    results[i] = play(seeds[i]);
+  }
+}
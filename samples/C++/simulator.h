@@ -0,0 +1,87 @@
+#pragma once
+
+#include "dropblox_ai.h"
+
+#include <vector>
+
+using namespace std;
+
+// A headless, local stand-in for the game server: it owns the board, draws
+// pieces from a seeded generator, keeps the preview list full, runs the AI in
+// process and applies its commands with the same Board rules the AI uses.
+//
+// Pieces are random polyominoes grown cell by cell from their center, so the
+// rotation pivot is always one of the piece's own squares. Scoring gives
+// 2^k - 1 points for a drop that clears k rows, and the game is over when the
+// next piece cannot be placed at its spawn position.
+
+// splitmix64: tiny, fast and identical on every platform, so a seed always
+// produces the same game.
+class Rng {
+ public:
+  Rng(unsigned long long seed);
+  unsigned long long next();
+  // Uniform integer in [0, n).
+  int below(int n);
+
+ private:
+  unsigned long long state;
+};
+
+class PieceGenerator {
+ public:
+  PieceGenerator(unsigned long long seed, int min_size, int max_size);
+
+  // Returns a new block at its spawn position. The caller owns it.
+  Block* next();
+
+ private:
+  Rng rng;
+  int min_size;
+  int max_size;
+};
+
+struct SimConfig {
+  // Lookahead passed to Board::choose_move.
+  int depth;
+  // Games are cut off after this many pieces (0 = play until topped out).
+  // Defaults to 500, since a decent AI rarely tops out on small pieces.
+  int max_pieces;
+  int min_piece_size;
+  int max_piece_size;
+  // If set, every state handed to the AI is saved in GameResult::record.
+  bool record;
+  // Heuristic weights the AI plays with. Defaults to default_heuristic_params.
+  float params[NUM_FEATURES];
+
+  SimConfig();
+};
+
+struct GameResult {
+  unsigned long long seed;
+  int score;
+  int pieces;
+  int rows_cleared;
+  bool topped_out;
+  double seconds;
+  // Corpus lines (see corpus.h) for each turn, if SimConfig::record is set.
+  string record;
+};
+
+class Simulator {
+ public:
+  Simulator(const SimConfig& config);
+
+  // Plays one complete game. The same seed always produces the same pieces.
+  GameResult play(unsigned long long seed) const;
+
+  // Plays one game per seed, spread across all cores with OpenMP. Results
+  // come back in seed order.
+  void play_many(const vector<unsigned long long>& seeds,
+                 vector<GameResult>& results) const;
+
+  // Points awarded for a single drop that clears `rows` rows.
+  static int points(int rows);
+
+  SimConfig config;
+};
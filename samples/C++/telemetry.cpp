@@ -0,0 +1,52 @@
+#include <cstring>
+#include <sys/resource.h>
+
+#include "telemetry.h"
+
+#ifdef DROPBLOX_TELEMETRY
+thread_local Telemetry telemetry;
+#endif
+
+Telemetry::Telemetry() {
+  reset();
+}
+
+void Telemetry::reset() {
+  memset(this, 0, sizeof(*this));
+  seconds_left = -1;
+}
+
+static double rate(long long hits, long long total) {
+  return total ? (double)hits / total : 0;
+}
+
+void Telemetry::emit(FILE* out) const {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  fprintf(out, "{\"parse_ms\": %.3f, \"generate_moves_ms\": %.3f, "
+          "\"generate_moves_calls\": %lld, \"open_boards\": %lld, "
+          "\"choose_move_ms\": {",
+          parse * 1e3, generate_moves * 1e3, generate_calls, open_boards);
+  // Keyed by remaining depth; each entry includes the deeper ones.
+  bool first = true;
+  for (int d = TELEMETRY_MAX_DEPTH - 1; d >= 0; d--) {
+    if (choose_move[d] > 0) {
+      fprintf(out, "%s\"%d\": %.3f", first ? "" : ", ", d, choose_move[d] * 1e3);
+      first = false;
+    }
+  }
+  fprintf(out, "}, \"output_ms\": %.3f, \"total_ms\": %.3f, ",
+          output * 1e3, total * 1e3);
+  if (seconds_left >= 0) {
+    fprintf(out, "\"time_left_ms\": %.3f, ", (seconds_left - total) * 1e3);
+  }
+  fprintf(out, "\"depth\": %d, \"positions\": %lld, \"dup_hits\": %lld, "
+          "\"dup_hit_rate\": %.4f, \"evaluations\": %lld, "
+          "\"candidates\": %lld, \"expanded\": %lld, \"pruned\": %lld, "
+          "\"prune_rate\": %.4f, \"peak_rss_kb\": %ld}\n",
+          depth, positions, dup_hits, rate(dup_hits, positions + dup_hits),
+          evaluations, candidates, expanded, pruned,
+          rate(pruned, candidates), usage.ru_maxrss);
+  fflush(out);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdio>
+
+// Per-turn search telemetry. Build with -DDROPBLOX_TELEMETRY (`make
+// TELEMETRY=1`) and dropblox_ai writes one JSON record per turn to stderr:
+// phase timings, how much of the move graph and search tree it visited and
+// its peak memory. Without the define, TELEMETRY(...) expands to nothing and
+// none of this is compiled in.
+//
+// There is no transposition table; "dup_hits" counts legal moves in the
+// path search behind commands_for (and the empty-board moves generate_moves
+// shares) that led to an already-visited position, which is the nearest
+// thing the search has to a table hit. "positions" counts that search's
+// visits; generate_moves works on whole rows of positions at a time.
+
+#define TELEMETRY_MAX_DEPTH 8
+
+struct Telemetry {
+  double seconds_left;
+  double parse;
+  double generate_moves;
+  double choose_move[TELEMETRY_MAX_DEPTH];
+  double output;
+  double total;
+
+  long long generate_calls;
+  // Calls that reused the empty board's moves instead of searching.
+  long long open_boards;
+  long long positions;
+  long long dup_hits;
+  long long evaluations;
+  long long candidates;
+  long long expanded;
+  long long pruned;
+  int depth;
+
+  Telemetry();
+  void reset();
+
+  // Writes the record as one line of JSON.
+  void emit(FILE* out) const;
+};
+
+#ifdef DROPBLOX_TELEMETRY
+
+// Each thread counts into its own record, so the simulator and other
+// multi-threaded drivers can be built with telemetry too.
+extern thread_local Telemetry telemetry;
+
+#define TELEMETRY(statement) statement
+
+#else
+
+#define TELEMETRY(statement)
+
+#endif
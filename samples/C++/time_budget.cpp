@@ -0,0 +1,29 @@
+#include <algorithm>
+
+#include "dropblox_ai.h"
+#include "time_budget.h"
+
+double turn_deadline(Board& board, double seconds_left, double start) {
+  double spendable = seconds_left - TIME_MARGIN;
+  if (spendable <= 0) {
+    return start;
+  }
+  int values[NUM_FEATURES];
+  Board::features(board.bitmap, values);
+
+  int cells = board.block->size;
+  for (int i = 0; i < board.preview.size(); i++) {
+    cells += board.preview[i]->size;
+  }
+  double piece_size = (double)cells / (board.preview.size() + 1);
+  double open_cells = ROWS * COLS - values[2] - values[0];
+  double moves_to_go = max((double)MIN_MOVES_TO_GO, open_cells / piece_size);
+
+  double height = min(1.0, (values[1] + HOLE_ROWS * values[0]) / ROWS);
+  double shares = 1 + 2 * height * height;
+  if (values[0] == 0 && values[3] <= OPEN_STEP) {
+    shares /= 2;
+  }
+  double budget = min(spendable / moves_to_go * shares, spendable * MAX_TURN_SHARE);
+  return start + budget;
+}
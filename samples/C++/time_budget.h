@@ -0,0 +1,36 @@
+#pragma once
+
+// Time management for a real turn. client.py passes the AI the seconds left
+// in the whole competition, not in the turn, and kills it if it is still
+// running when they are up, so a turn that takes too long forfeits every
+// move after it. Each turn instead takes a share of what is left, sized by
+// how much the board needs it, and the search deepens until that runs out.
+
+class Board;
+
+// Seconds kept back from every turn for starting the process, printing the
+// moves and exiting.
+#define TIME_MARGIN 0.05
+// The fewest moves the time left is spread over. The competition does not
+// say how many remain, so turn_deadline estimates it from the board: the
+// moves it would take the coming pieces to fill the cells that are neither
+// filled nor holes. A low board spreads the time over more moves than one
+// near the top, and every turn still leaves most of the clock for the rest.
+#define MIN_MOVES_TO_GO 10
+// No turn takes more than this fraction of the time left.
+#define MAX_TURN_SHARE 0.1
+// Each hole counts as this many rows of stack when sizing a turn's share,
+// since a low board riddled with holes is no easier than a taller clean one.
+#define HOLE_ROWS 0.5
+// A surface with no holes and no step taller than this is open: most pieces
+// have somewhere flat to go, so the turn takes half a share.
+#define OPEN_STEP 2
+// A search stops deepening once its best placement beats the runner-up by
+// this fraction of its score.
+#define DOMINANT_MARGIN 0.5
+
+// The omp_get_wtime() time by which a turn that started at `start`, with
+// `seconds_left` in the competition, should have its move. Low, open
+// surfaces get half a share and boards whose stack, holes included, nears
+// the top up to three.
+double turn_deadline(Board& board, double seconds_left, double start);
@@ -0,0 +1,92 @@
+#include "timers.h"
+
+#ifdef DROPBLOX_TIMERS
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+using namespace std;
+
+// Threads past this many count into a slot of their own that is never
+// summed; the summary says how many there were.
+#define MAX_TIMER_THREADS 256
+
+static const char* timer_names[NUM_TIMERS] = {
+  "check",
+  "place",
+  "remove_rows",
+  "get_score",
+  "score_placement",
+  "count_holes",
+  "altitude",
+  "full_cells",
+  "higher_slope",
+  "roughness",
+  "full_cells_weighted",
+  "countComponents",
+};
+
+static TimerCounts slots[MAX_TIMER_THREADS];
+static atomic<int> slots_used(0);
+static thread_local TimerCounts* thread_slot = NULL;
+static thread_local TimerCounts uncounted_slot;
+
+TimerCounts& timer_counts() {
+  if (!thread_slot) {
+    int slot = slots_used.fetch_add(1);
+    thread_slot = slot < MAX_TIMER_THREADS ? &slots[slot] : &uncounted_slot;
+  }
+  return *thread_slot;
+}
+
+static double clock_seconds() {
+  return chrono::duration<double>(
+      chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Notes the tick counter and the clock at startup, and prints the summary at
+// exit once it knows how long a tick is.
+class TimerSummary {
+ public:
+  TimerSummary() : start_ticks(timer_ticks()), start_seconds(clock_seconds()) {}
+
+  ~TimerSummary() {
+    double seconds = clock_seconds() - start_seconds;
+    unsigned long long ticks = timer_ticks() - start_ticks;
+    double ns_per_tick = ticks ? seconds * 1e9 / ticks : 0;
+
+    TimerCounts total = {};
+    int used = min(slots_used.load(), MAX_TIMER_THREADS);
+    for (int t = 0; t < used; t++) {
+      for (int k = 0; k < NUM_TIMERS; k++) {
+        total.calls[k] += slots[t].calls[k];
+        total.ticks[k] += slots[t].ticks[k];
+      }
+    }
+
+    fprintf(stderr, "%-20s %14s %12s %10s %7s\n",
+            "timer", "calls", "total ms", "ns/call", "% run");
+    for (int k = 0; k < NUM_TIMERS; k++) {
+      if (!total.calls[k]) continue;
+      double ns = total.ticks[k] * ns_per_tick;
+      fprintf(stderr, "%-20s %14llu %12.3f %10.1f %6.1f%%\n", timer_names[k],
+              total.calls[k], ns / 1e6, ns / total.calls[k],
+              seconds > 0 ? ns / (seconds * 1e9) * 100 : 0);
+    }
+    fprintf(stderr, "%d thread(s), %.3fs wall, times are inclusive\n",
+            used, seconds);
+    if (slots_used.load() > MAX_TIMER_THREADS) {
+      fprintf(stderr, "%d more thread(s) past MAX_TIMER_THREADS not counted\n",
+              slots_used.load() - MAX_TIMER_THREADS);
+    }
+  }
+
+ private:
+  unsigned long long start_ticks;
+  double start_seconds;
+};
+
+static TimerSummary summary;
+
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+
+// Scoped timers for the engine's hot paths. These functions take tens to
+// hundreds of nanoseconds, which is too fine for a sampling profiler to
+// attribute, so each one opens a ScopedTimer that counts calls and elapsed
+// ticks. Times are inclusive: place() includes the check() and remove_rows()
+// calls it makes, and get_score() includes the features.
+//
+// Build with -DDROPBLOX_TIMERS (`make TIMERS=1`) and a summary table goes to
+// stderr when the process exits. Otherwise ScopedTimer is an empty class with
+// an empty inline constructor and compiles away completely.
+//
+// Every thread counts into its own slot and slots are only summed at exit, so
+// timing never takes a lock or an atomic in the hot path.
+
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef DROPBLOX_TIMERS
+const bool timers_enabled = true;
+#else
+const bool timers_enabled = false;
+#endif
+
+enum TimerId {
+  TIMER_CHECK,
+  TIMER_PLACE,
+  TIMER_REMOVE_ROWS,
+  TIMER_GET_SCORE,
+  TIMER_SCORE_PLACEMENT,
+  TIMER_COUNT_HOLES,
+  TIMER_ALTITUDE,
+  TIMER_FULL_CELLS,
+  TIMER_HIGHER_SLOPE,
+  TIMER_ROUGHNESS,
+  TIMER_FULL_CELLS_WEIGHTED,
+  TIMER_COUNT_COMPONENTS,
+  NUM_TIMERS
+};
+
+// One thread's counters. Each starts on its own cache line, so threads
+// counting into neighbouring slots do not share one.
+struct alignas(64) TimerCounts {
+  unsigned long long calls[NUM_TIMERS];
+  unsigned long long ticks[NUM_TIMERS];
+};
+
+// rdtsc where available, steady_clock nanoseconds elsewhere. The summary
+// converts ticks to time by calibrating against steady_clock over the run.
+inline unsigned long long timer_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// The calling thread's counters.
+TimerCounts& timer_counts();
+
+template <bool enabled>
+class ScopedTimerImpl {
+ public:
+  explicit ScopedTimerImpl(TimerId) {}
+};
+
+template <>
+class ScopedTimerImpl<true> {
+ public:
+  explicit ScopedTimerImpl(TimerId id) : id(id), start(timer_ticks()) {}
+  ~ScopedTimerImpl() {
+    TimerCounts& counts = timer_counts();
+    counts.calls[id]++;
+    counts.ticks[id] += timer_ticks() - start;
+  }
+
+ private:
+  TimerId id;
+  unsigned long long start;
+};
+
+typedef ScopedTimerImpl<timers_enabled> ScopedTimer;
@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include "omp.h"
+#include "trace.h"
+
+using namespace std;
+
+static const char* trace_path = getenv("DROPBLOX_TRACE");
+const bool trace_enabled = trace_path && *trace_path;
+
+struct TraceEvent {
+  const char* name;
+  int depth;
+  int candidate;
+  double start;
+  double duration;
+};
+
+// Each thread appends to its own buffer. Buffers are registered once per
+// thread and never freed, so OpenMP workers may exit before the file is
+// written at process exit.
+struct TraceBuffer {
+  int tid;
+  vector<TraceEvent> events;
+};
+
+static mutex buffers_lock;
+static vector<TraceBuffer*> buffers;
+static thread_local TraceBuffer* thread_buffer = NULL;
+static double trace_start = omp_get_wtime();
+
+static TraceBuffer& buffer() {
+  if (!thread_buffer) {
+    lock_guard<mutex> lock(buffers_lock);
+    thread_buffer = new TraceBuffer();
+    thread_buffer->tid = buffers.size();
+    buffers.push_back(thread_buffer);
+  }
+  return *thread_buffer;
+}
+
+void TraceSpan::begin(const char* name, int depth, int candidate) {
+  this->name = name;
+  this->depth = depth;
+  this->candidate = candidate;
+  start = omp_get_wtime();
+}
+
+void TraceSpan::end() {
+  TraceEvent event = {name, depth, candidate, start, omp_get_wtime() - start};
+  buffer().events.push_back(event);
+}
+
+// Writes the trace when the process exits.
+class TraceWriter {
+ public:
+  ~TraceWriter() {
+    if (!trace_enabled) return;
+    FILE* out = fopen(trace_path, "w");
+    if (!out) {
+      fprintf(stderr, "cannot write trace to %s\n", trace_path);
+      return;
+    }
+
+    lock_guard<mutex> lock(buffers_lock);
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(out, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"args\": {\"name\": \"dropblox search\"}}");
+    for (int b = 0; b < buffers.size(); b++) {
+      const TraceBuffer& buffer = *buffers[b];
+      fprintf(out, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+              "\"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+              buffer.tid, buffer.tid);
+      for (int k = 0; k < buffer.events.size(); k++) {
+        const TraceEvent& event = buffer.events[k];
+        fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+                "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+                "\"args\": {\"depth\": %d", event.name, buffer.tid,
+                (event.start - trace_start) * 1e6, event.duration * 1e6,
+                event.depth);
+        if (event.candidate >= 0) {
+          fprintf(out, ", \"candidate\": %d", event.candidate);
+        }
+        fprintf(out, "}}");
+      }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+  }
+};
+
+static TraceWriter writer;
@@ -0,0 +1,35 @@
+#pragma once
+
+// Timeline tracing of the search. Set DROPBLOX_TRACE to a file name and every
+// generate_moves and choose_move call made through Board::search is recorded
+// as a span, tagged with its remaining search depth, the index of the
+// candidate placement it is expanding (in score order) and the thread it ran
+// on. At exit the spans are written to that file in Chrome trace-event JSON,
+// which loads in Perfetto (ui.perfetto.dev) or chrome://tracing.
+//
+// dropblox_ai writes one turn per run; ./simulate and ./replay trace every
+// turn they play. When DROPBLOX_TRACE is unset a span costs one branch.
+
+// Whether DROPBLOX_TRACE was set at startup.
+extern const bool trace_enabled;
+
+class TraceSpan {
+ public:
+  // `name` must outlive the process (a string literal). A negative
+  // `candidate` means the span is not under a particular candidate.
+  TraceSpan(const char* name, int depth, int candidate = -1) {
+    if (trace_enabled) begin(name, depth, candidate);
+  }
+  ~TraceSpan() {
+    if (trace_enabled) end();
+  }
+
+ private:
+  void begin(const char* name, int depth, int candidate);
+  void end();
+
+  const char* name;
+  int depth;
+  int candidate;
+  double start;
+};
@@ -0,0 +1,201 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "simulator.h"
+
+using namespace std;
+
+// Tunes the get_score weights by self-play, with the cross-entropy method.
+// Usage:
+//
+//   ./tune [--generations G] [--population N] [--elite E] [--games M]
+//          [--seed S] [--depth D] [--max-pieces P] [--min-size A]
+//          [--max-size B] [--threads T] [--out FILE] [--weights W]
+//
+// Each generation samples N weight vectors from a Gaussian around the current
+// mean and plays M simulated games with each one. The E best vectors by mean
+// game score become the next mean and spread. Every candidate in a generation
+// plays the same M seeds (common random numbers), so differences between
+// candidates come from the weights rather than from luckier pieces. Each
+// generation draws fresh seeds so the weights do not fit one set of games.
+// All N * M games of a generation run in parallel.
+//
+// Candidate 0 of each generation is the current mean itself, so the log shows
+// how the mean weights are doing. After every generation the mean is written
+// to FILE (default weights.txt) in the format below, which the engine loads.
+//
+//   # holes altitude full_cells higher_slope roughness full_cells_weighted components
+//   20 1 2 5 5 0 10
+//
+// The search starts from the default weights, or from --weights W (a weight
+// file or a list, see load_heuristic_params). Weights are kept non-negative:
+// every feature measures something bad.
+
+void usage(const char* name) {
+  cerr << "usage: " << name << " [--generations G] [--population N]"
+       << " [--elite E] [--games M] [--seed S] [--depth D] [--max-pieces P]"
+       << " [--min-size A] [--max-size B] [--threads T] [--out FILE]"
+       << " [--weights W]" << endl;
+  exit(1);
+}
+
+// Standard normal sample (Box-Muller).
+double gaussian(Rng& rng) {
+  double u = (rng.next() >> 11) * (1.0 / 9007199254740992.0);
+  double v = (rng.next() >> 11) * (1.0 / 9007199254740992.0);
+  return sqrt(-2 * log(1 - u)) * cos(2 * M_PI * v);
+}
+
+bool write_weights(const char* path, const float* params) {
+  FILE* out = fopen(path, "w");
+  if (!out) return false;
+  fprintf(out, "# holes altitude full_cells higher_slope roughness "
+          "full_cells_weighted components\n");
+  for (int k = 0; k < NUM_FEATURES; k++) {
+    fprintf(out, "%s%g", k ? " " : "", params[k]);
+  }
+  fprintf(out, "\n");
+  fclose(out);
+  return true;
+}
+
+void print_weights(const float* params) {
+  printf("[");
+  for (int k = 0; k < NUM_FEATURES; k++) {
+    printf("%s%.3g", k ? " " : "", params[k]);
+  }
+  printf("]");
+}
+
+int main(int argc, char** argv) {
+  SimConfig config;
+  config.depth = 0;
+  config.max_pieces = 200;
+  int generations = 20;
+  int population = 24;
+  int elite = 6;
+  int games = 16;
+  unsigned long long seed = 1;
+  const char* out_path = "weights.txt";
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) usage(argv[0]);
+    const char* value = argv[++i];
+    if (!strcmp(argv[i - 1], "--generations")) {
+      generations = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--population")) {
+      population = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--elite")) {
+      elite = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--games")) {
+      games = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--seed")) {
+      seed = strtoull(value, NULL, 10);
+    } else if (!strcmp(argv[i - 1], "--depth")) {
+      config.depth = atoi(value);
+      if (config.depth < 0 || config.depth > MAX_SEARCH_DEPTH) {
+        cerr << "--depth must be between 0 and " << MAX_SEARCH_DEPTH << endl;
+        return 1;
+      }
+    } else if (!strcmp(argv[i - 1], "--max-pieces")) {
+      config.max_pieces = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--min-size")) {
+      config.min_piece_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--max-size")) {
+      config.max_piece_size = atoi(value);
+    } else if (!strcmp(argv[i - 1], "--threads")) {
+      omp_set_num_threads(atoi(value));
+    } else if (!strcmp(argv[i - 1], "--out")) {
+      out_path = value;
+    } else if (!strcmp(argv[i - 1], "--weights")) {
+      if (!load_heuristic_params(value, config.params)) {
+        cerr << "bad weights: " << value << endl;
+        return 1;
+      }
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (generations <= 0 || games <= 0 || population < 2 || elite < 1 ||
+      elite > population || config.min_piece_size < 1 ||
+      config.max_piece_size > 10 ||
+      config.min_piece_size > config.max_piece_size) {
+    usage(argv[0]);
+  }
+
+  float mean[NUM_FEATURES];
+  float spread[NUM_FEATURES];
+  for (int k = 0; k < NUM_FEATURES; k++) {
+    mean[k] = config.params[k];
+    spread[k] = max(1.0f, mean[k] / 2);
+  }
+
+  Rng rng(seed);
+  vector<vector<float> > candidates(population, vector<float>(NUM_FEATURES));
+  vector<GameResult> results(population * games);
+  double start = omp_get_wtime();
+
+  for (int g = 0; g < generations; g++) {
+    for (int c = 0; c < population; c++) {
+      for (int k = 0; k < NUM_FEATURES; k++) {
+        float w = mean[k];
+        if (c > 0) w += spread[k] * gaussian(rng);
+        candidates[c][k] = max(0.0f, w);
+      }
+    }
+
+    // One flat loop over every (candidate, game) pair balances better across
+    // cores than parallelising within each candidate.
+    unsigned long long first_seed = seed + (unsigned long long)g * games;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int n = 0; n < population * games; n++) {
+      SimConfig game_config = config;
+      memcpy(game_config.params, &candidates[n / games][0],
+             sizeof(game_config.params));
+      results[n] = Simulator(game_config).play(first_seed + n % games);
+    }
+
+    vector<pair<double, int> > ranked;
+    for (int c = 0; c < population; c++) {
+      long long total = 0;
+      for (int i = 0; i < games; i++) {
+        total += results[c * games + i].score;
+      }
+      ranked.push_back(make_pair(-(double)total / games, c));
+    }
+    sort(ranked.begin(), ranked.end());
+
+    double mean_score = 0;
+    for (int r = 0; r < population; r++) {
+      if (ranked[r].second == 0) mean_score = -ranked[r].first;
+    }
+
+    for (int k = 0; k < NUM_FEATURES; k++) {
+      double sum = 0, sum_sq = 0;
+      for (int r = 0; r < elite; r++) {
+        float w = candidates[ranked[r].second][k];
+        sum += w;
+        sum_sq += w * w;
+      }
+      mean[k] = sum / elite;
+      // Keep a little spread so the search does not freeze early.
+      spread[k] = max(0.1, sqrt(max(0.0, sum_sq / elite - mean[k] * mean[k])));
+    }
+
+    printf("generation %d: best %.2f, mean weights scored %.2f, %.0fs, next ", g,
+           -ranked[0].first, mean_score, omp_get_wtime() - start);
+    print_weights(mean);
+    printf("\n");
+    fflush(stdout);
+
+    if (!write_weights(out_path, mean)) {
+      cerr << "cannot write " << out_path << endl;
+      return 1;
+    }
+  }
+  return 0;
+}